@@ -28,7 +28,10 @@
 
 #include "cif++/utilities.hpp"
 #include "cif++/file.hpp"
+#include "cif++/column_store.hpp"
+#include "cif++/prepared_query.hpp"
 #include "cif++/parser.hpp"
+#include "cif++/streaming_parser.hpp"
 #include "cif++/format.hpp"
 
 #include "cif++/compound.hpp"
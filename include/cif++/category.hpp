@@ -34,6 +34,8 @@
 #include "cif++/validate.hpp"
 
 #include <array>
+#include <mutex>
+#include <unordered_map>
 
 // TODO: implement all of:
 // https://en.cppreference.com/w/cpp/named_req/Container
@@ -75,6 +77,12 @@ class category
 {
   public:
 	friend class row_handle;
+	friend class parser;
+	friend class column_store;
+	friend class column_ref;
+	friend class condition;
+	friend class detail::condition_program;
+	friend class prepared_query;
 
 	template <typename, typename...>
 	friend class iterator_impl;
@@ -85,7 +93,7 @@ class category
 	using iterator = iterator_impl<category>;
 	using const_iterator = iterator_impl<const category>;
 
-	category() = default;
+	category();
 
 	category(std::string_view name);
 
@@ -116,6 +124,14 @@ class category
 	bool is_valid() const;
 	bool validate_links() const;
 
+	/// \brief Append the problems in the structure of this category, like
+	/// unknown items or missing mandatory items, to \a report
+	void validate_structure(validation_report &report) const;
+
+	/// \brief Validate the values in the rows [\a b, \a e) and append the
+	/// problems found to \a report. \a row_nr is the index of the row \a b.
+	void validate_values(validation_report &report, const_iterator b, const_iterator e, std::size_t row_nr = 0) const;
+
 	bool operator==(const category &rhs) const;
 	bool operator!=(const category &rhs) const
 	{
@@ -176,7 +192,7 @@ class category
 
 	size_t size() const
 	{
-		return std::distance(cbegin(), cend());
+		return m_size;
 	}
 
 	bool empty() const
@@ -238,6 +254,32 @@ class category
 		return conditional_iterator_proxy<const category>{ *this, pos, std::move(cond) };
 	}
 
+	/// \brief Return the rows that match \a cond, in the order of the
+	/// category. With cif::execution::par the rows are tested in chunks on
+	/// multiple threads before the result is returned.
+
+	conditional_iterator_proxy<category> find(const execution::parallel_policy &policy, condition &&cond)
+	{
+		prepare_parallel(cond, policy.m_thread_count);
+		return find(begin(), std::move(cond));
+	}
+
+	conditional_iterator_proxy<const category> find(const execution::parallel_policy &policy, condition &&cond) const
+	{
+		prepare_parallel(cond, policy.m_thread_count);
+		return find(cbegin(), std::move(cond));
+	}
+
+	conditional_iterator_proxy<category> find(const execution::sequenced_policy &, condition &&cond)
+	{
+		return find(std::move(cond));
+	}
+
+	conditional_iterator_proxy<const category> find(const execution::sequenced_policy &, condition &&cond) const
+	{
+		return find(std::move(cond));
+	}
+
 	template <typename... Ts, typename... Ns>
 	conditional_iterator_proxy<category, Ts...> find(condition &&cond, Ns... names)
 	{
@@ -276,7 +318,7 @@ class category
 
 	row_handle find1(iterator pos, condition &&cond)
 	{
-		auto h = find(pos, std::move(cond));
+		auto h = find(pos, std::move(cond)).limit(2);
 
 		if (h.size() != 1)
 			throw multiple_results_error();
@@ -291,7 +333,7 @@ class category
 
 	const row_handle find1(const_iterator pos, condition &&cond) const
 	{
-		auto h = find(pos, std::move(cond));
+		auto h = find(pos, std::move(cond)).limit(2);
 
 		if (h.size() != 1)
 			throw multiple_results_error();
@@ -308,7 +350,7 @@ class category
 	template <typename T, std::enable_if_t<not is_optional_v<T>, int> = 0>
 	T find1(const_iterator pos, condition &&cond, const char *column) const
 	{
-		auto h = find<T>(pos, std::move(cond), column);
+		auto h = find<T>(pos, std::move(cond), column).limit(2);
 
 		if (h.size() != 1)
 			throw multiple_results_error();
@@ -319,7 +361,7 @@ class category
 	template <typename T, std::enable_if_t<is_optional_v<T>, int> = 0>
 	T find1(const_iterator pos, condition &&cond, const char *column) const
 	{
-		auto h = find<typename T::value_type>(pos, std::move(cond), column);
+		auto h = find<typename T::value_type>(pos, std::move(cond), column).limit(2);
 
 		if (h.size() > 1)
 			throw multiple_results_error();
@@ -342,7 +384,7 @@ class category
 	std::tuple<Ts...> find1(const_iterator pos, condition &&cond, Cs... columns) const
 	{
 		static_assert(sizeof...(Ts) == sizeof...(Cs), "The number of column titles should be equal to the number of types to return");
-		auto h = find<Ts...>(pos, std::move(cond), std::forward<Cs>(columns)...);
+		auto h = find<Ts...>(pos, std::move(cond), std::forward<Cs>(columns)...).limit(2);
 
 		if (h.size() != 1)
 			throw multiple_results_error();
@@ -456,12 +498,26 @@ class category
 
 		if (cond)
 		{
-			cond.prepare(*this);
+			if (not cond.prepared())
+				cond.prepare(*this);
 
 			auto sh = cond.single();
 
 			if (sh.has_value() and *sh)
 				result = true;
+			else if (auto cs = cond.candidates(); cs != nullptr)
+			{
+				for (auto r : *cs)
+				{
+					if (cond({ *this, *r }))
+					{
+						result = true;
+						break;
+					}
+				}
+			}
+			else if (auto program = cond.program(); program != nullptr)
+				result = program->find_next(m_head) != nullptr;
 			else
 			{
 				for (auto r : *this)
@@ -484,12 +540,23 @@ class category
 
 		if (cond)
 		{
-			cond.prepare(*this);
+			if (not cond.prepared())
+				cond.prepare(*this);
 
 			auto sh = cond.single();
 
 			if (sh.has_value() and *sh)
 				result = 1;
+			else if (auto cs = cond.candidates(); cs != nullptr)
+			{
+				for (auto r : *cs)
+				{
+					if (cond({ *this, *r }))
+						++result;
+				}
+			}
+			else if (auto program = cond.program(); program != nullptr)
+				result = program->count(m_head);
 			else
 			{
 				for (auto r : *this)
@@ -503,6 +570,24 @@ class category
 		return result;
 	}
 
+	/// \brief Return whether a row matches \a cond, testing the rows on
+	/// multiple threads. All threads stop when one of them finds a match.
+	bool exists(const execution::parallel_policy &policy, condition &&cond) const;
+
+	bool exists(const execution::sequenced_policy &, condition &&cond) const
+	{
+		return exists(std::move(cond));
+	}
+
+	/// \brief Return the number of rows that match \a cond, testing the
+	/// rows on multiple threads
+	size_t count(const execution::parallel_policy &policy, condition &&cond) const;
+
+	size_t count(const execution::sequenced_policy &, condition &&cond) const
+	{
+		return count(std::move(cond));
+	}
+
 	// --------------------------------------------------------------------
 
 	bool has_children(row_handle r) const;
@@ -533,6 +618,23 @@ class category
 	size_t erase(condition &&cond);
 	size_t erase(condition &&cond, std::function<void(row_handle)> &&visit);
 
+	/// \brief Erase the rows that match \a cond, these are found by testing
+	/// the rows on multiple threads. The rows are erased in order, on the
+	/// calling thread.
+	size_t erase(const execution::parallel_policy &policy, condition &&cond)
+	{
+		return erase(policy, std::move(cond), {});
+	}
+
+	/// \brief Erase the rows that match \a cond like above, calling \a visit
+	/// for each row before it is erased
+	size_t erase(const execution::parallel_policy &policy, condition &&cond, std::function<void(row_handle)> &&visit);
+
+	size_t erase(const execution::sequenced_policy &, condition &&cond)
+	{
+		return erase(std::move(cond));
+	}
+
 	iterator emplace(row_initializer &&ri)
 	{
 		return this->emplace(ri.begin(), ri.end());
@@ -548,7 +650,7 @@ class category
 			for (auto i = b; i != e; ++i)
 			{
 				// item_value *new_item = this->create_item(*i);
-				r->append(add_column(i->name()), { i->value() });
+				store_value(r, add_column(i->name()), i->value());
 			}
 		}
 		catch (...)
@@ -563,6 +665,53 @@ class category
 
 	void clear();
 
+	// --------------------------------------------------------------------
+	/// \brief A bulk_inserter appends rows to a category without maintaining
+	/// the key index for each row separately. When the bulk_inserter is
+	/// committed the index is updated in one go. Rows having a duplicate key
+	/// are then removed from the category and reported all at once in a
+	/// single duplicate_key_error.
+	///
+	/// commit must be called explicitly. The destructor only commits when
+	/// this was not done because an exception was thrown, to keep the
+	/// category consistent. Duplicate keys found there cannot be thrown
+	/// and are written to std::cerr instead.
+	///
+	/// While a bulk_inserter is active, lookups in the category do not use
+	/// the index. There can be only one bulk_inserter at a time for a
+	/// category and the category should not be moved while it is active.
+
+	class bulk_inserter
+	{
+	  public:
+		bulk_inserter(category &cat);
+		~bulk_inserter();
+
+		bulk_inserter(const bulk_inserter &) = delete;
+		bulk_inserter &operator=(const bulk_inserter &) = delete;
+
+		iterator emplace(row_initializer &&ri)
+		{
+			return m_category.emplace(ri.begin(), ri.end());
+		}
+
+		template <typename ItemIter>
+		iterator emplace(ItemIter b, ItemIter e)
+		{
+			return m_category.emplace(b, e);
+		}
+
+		/// \brief Update the index, throws a duplicate_key_error listing all
+		/// rows that were removed because their key was not unique.
+		void commit();
+
+	  private:
+		category &m_category;
+		row *m_last;
+		bool m_committed = false;
+		int m_uncaught_exceptions;
+	};
+
 	// --------------------------------------------------------------------
 	/// \brief generate a new, unique ID. Pass it an ID generating function
 	/// based on a sequence number. This function will be called until the
@@ -596,13 +745,10 @@ class category
 
 	uint16_t get_column_ix(std::string_view column_name) const
 	{
-		uint16_t result;
+		uint16_t result = static_cast<uint16_t>(m_columns.size());
 
-		for (result = 0; result < m_columns.size(); ++result)
-		{
-			if (iequals(column_name, m_columns[result].m_name))
-				break;
-		}
+		if (auto i = m_column_index.find(column_name); i != m_column_index.end())
+			result = i->second;
 
 		if (VERBOSE > 0 and result == m_columns.size() and m_cat_validator != nullptr) // validate the name, if it is known at all (since it was not found)
 		{
@@ -640,6 +786,7 @@ class category
 			}
 
 			m_columns.emplace_back(column_name, item_validator);
+			m_column_index.emplace(column_name, result);
 		}
 
 		return result;
@@ -652,6 +799,80 @@ class category
 
 	iset get_columns() const;
 
+	// --------------------------------------------------------------------
+	/// \brief Intern the values of column \a column_name. Each distinct value
+	/// is then stored only once, in a table shared by all rows. This saves
+	/// memory and speeds up conditions testing for equality, since values
+	/// can be compared by their id. Use this for columns that contain only
+	/// a few distinct values, like type_symbol or label_comp_id in atom_site.
+
+	void intern_column(std::string_view column_name);
+
+	/// \brief Intern all columns having at most \a max_distinct different
+	/// values, provided these are repeated at least four times on average.
+	/// Useful after loading a large category.
+
+	void intern_repeated_values(std::size_t max_distinct = 256);
+
+	/// \brief Return whether the values of column \a column_name are interned
+
+	bool is_interned(std::string_view column_name) const
+	{
+		auto ix = get_column_ix(column_name);
+		return ix < m_columns.size() and m_columns[ix].m_interned;
+	}
+
+	/// \brief Return the table containing the values of column \a column_ix
+	/// if it is interned, nullptr otherwise
+
+	const string_table *get_string_table(uint16_t column_ix) const;
+
+	// --------------------------------------------------------------------
+	/// \brief Return a copy of the data in this category stored per column,
+	/// see column_store.hpp. It is created on first use and remains valid
+	/// until this category is modified. Const methods may call this from
+	/// multiple threads.
+
+	const column_store &get_column_store() const;
+
+	// --------------------------------------------------------------------
+	/// \brief Create a secondary index on the columns \a columns, e.g.:
+	///
+	/// \code{.cpp}
+	/// atom_site.create_index({ "label_asym_id", "label_seq_id" });
+	/// \endcode
+	///
+	/// The index is kept up to date when rows are inserted, updated or erased.
+	/// Conditions that test for equality of the first columns of the index, and
+	/// optionally compare the next column with a number, use the index to find
+	/// rows. The latter only works for columns of type numb. Creating an index
+	/// that already exists does nothing.
+
+	void create_index(const std::vector<std::string> &columns);
+
+	/// \brief Return whether there is a secondary index on exactly \a columns
+
+	bool has_index(const std::vector<std::string> &columns) const;
+
+	/// \brief Remove the secondary index on \a columns, if there is one
+
+	void drop_index(const std::vector<std::string> &columns);
+
+	/// \brief Create secondary indices on the items of this category that
+	/// link to items in other categories, according to the dictionary. With
+	/// these, finding children and parents and cascading updates and erases
+	/// use an index instead of scanning the whole category. Items linking
+	/// to a key consisting of a single item already use the key index.
+
+	void create_link_indices();
+
+	/// \brief Return statistics on the values in column \a column, estimated
+	/// from a sample of the rows. These are used to plan the evaluation of
+	/// conditions and are recalculated once the number of rows has changed
+	/// considerably. Const methods may call this from multiple threads.
+
+	column_statistics get_column_statistics(uint16_t column) const;
+
 	// --------------------------------------------------------------------
 
 	void sort(std::function<int(row_handle, row_handle)> f);
@@ -680,32 +901,72 @@ class category
   private:
 	void erase_orphans(condition &&cond, category &parent);
 
-	using allocator_type = std::allocator<void>;
+	void discard_saved_index();
+	void discard_column_store();
+	void commit_bulk_insert(row *last);
 
-	constexpr allocator_type get_allocator() const
-	{
-		return {};
-	}
+	// Find the rows that may match one of the sets of tests in \a alternatives
+	// using the best secondary index for each, in the order of this category.
+	// Returns nothing if an index cannot be used for each of the alternatives.
+	// A description of the indices used is written to \a plan.
+	std::optional<std::vector<row *>> find_candidates(const std::vector<detail::index_terms> &alternatives, std::string &plan) const;
 
-	using char_allocator_type = typename std::allocator_traits<allocator_type>::template rebind_alloc<char>;
-	using char_allocator_traits = std::allocator_traits<char_allocator_type>;
+	// Return the row with the key values in \a terms, if the key index can be used
+	std::optional<row *> find_by_key_terms(const detail::index_terms &terms) const;
 
-	using row_allocator_type = typename std::allocator_traits<allocator_type>::template rebind_alloc<row>;
-	using row_allocator_traits = std::allocator_traits<row_allocator_type>;
+	// Rows are tested in parallel in chunks of this many rows
+	static constexpr size_t kParallelChunkSize = 8 * detail::condition_program::kBatchSize;
 
-	row_allocator_traits::pointer get_row()
-	{
-		row_allocator_type ra(get_allocator());
-		return row_allocator_traits::allocate(ra, 1);
-	}
+	// Test all rows against the prepared condition \a cond, in chunks on at
+	// most \a thread_count threads. Returns the number of rows that match and
+	// stores them in \a rows, in order, if it is not null. With \a any, all
+	// threads stop as soon as a match is found.
+	size_t scan_parallel(const condition &cond, std::size_t thread_count, std::vector<row *> *rows, bool any) const;
 
-	row *create_row()
+	// Prepare \a cond and, if all rows need to be tested, find the rows that
+	// match using scan_parallel. These become the candidates of \a cond.
+	void prepare_parallel(condition &cond, std::size_t thread_count) const;
+
+	// Number the rows in m_ordinal, in the order of this category
+	void update_ordinals() const;
+
+	// Rows are allocated from a pool, create_row is thread safe
+	row *create_row();
+
+	// Allocates rows for this category from a pool of its own, for use
+	// by a single thread. Rows created this way are owned by the
+	// allocator until it is merged into the category, so that the rows
+	// of one thread are kept together and threads do not contend for
+	// the pool of the category.
+	class row_allocator
 	{
-		auto p = this->get_row();
-		row_allocator_type ra(get_allocator());
-		row_allocator_traits::construct(ra, p);
-		return p;
-	}
+	  public:
+		row_allocator(category &cat);
+		row_allocator(const row_allocator &) = delete;
+		row_allocator &operator=(const row_allocator &) = delete;
+		~row_allocator();
+
+		row *create_row();
+
+		// The arena for the long values of the rows created here
+		string_arena &get_arena();
+
+	  private:
+		friend class category;
+
+		category &m_category;
+		class row_pool *m_pool;
+	};
+
+	// Take over the rows and values of \a allocator, the rows can then
+	// be inserted in this category. Not thread safe
+	void merge(row_allocator &allocator);
+
+	// The arena for storing long values of items, not thread safe
+	string_arena &get_arena();
+
+	// Store non-empty \a value in \a r, interning it if needed. Not thread safe
+	void store_value(row *r, uint16_t column, std::string_view value);
 
 	row *clone_row(const row &r);
 
@@ -717,6 +978,7 @@ class category
 	{
 		std::string m_name;
 		const item_validator *m_validator;
+		bool m_interned = false;
 
 		item_column(std::string_view name, const item_validator *validator)
 			: m_name(name)
@@ -754,13 +1016,130 @@ class category
 
 	std::string m_name;
 	std::vector<item_column> m_columns;
+	std::unordered_map<std::string, uint16_t, ihash, iequal_to> m_column_index;
 	const validator *m_validator = nullptr;
 	const category_validator *m_cat_validator = nullptr;
 	std::vector<link> m_parent_links, m_child_links;
 	bool m_cascade = true;
 	uint32_t m_last_unique_num = 0;
 	class category_index *m_index = nullptr;
+	class category_index *m_saved_index = nullptr;
+	bool m_deferred_index = false;
+	class row_pool *m_pool = nullptr;
+	mutable column_store *m_column_store = nullptr;
+
+	// incremented each time the category is modified, see discard_column_store
+	uint32_t m_generation = 0;
+
+	// incremented each time m_columns is replaced, see column_ref
+	uint32_t m_column_layout = 0;
+	std::vector<class secondary_index *> m_secondary_indices;
 	row *m_head = nullptr, *m_tail = nullptr;
+	size_t m_size = 0;
+
+	// guards m_ordinals_valid, m_ordinal of the rows, m_statistics and
+	// m_column_store, these are updated by const methods
+	mutable std::mutex m_cache_mutex;
+
+	// whether m_ordinal of the rows reflects their order
+	mutable bool m_ordinals_valid = true;
+
+	// the statistics per column and the number of rows they were estimated for
+	mutable std::vector<std::optional<column_statistics>> m_statistics;
+	mutable size_t m_statistics_size = 0;
+};
+
+// --------------------------------------------------------------------
+/// \brief A column_ref is a column name resolved once to its index in a
+/// category. Use it to access the same column in many rows without looking
+/// up the name each time, e.g.:
+///
+/// \code{.cpp}
+/// cif::column_ref asym_id(atom_site, "label_asym_id");
+/// for (auto r : atom_site)
+/// 	std::cout << r[asym_id].text() << '\n';
+/// \endcode
+///
+/// Columns are only added to a category, the index of an existing column
+/// therefore remains valid until the category is assigned to, which
+/// replaces all of its columns. The category counts these assignments and
+/// the name is looked up again after one. The same happens when the column
+/// did not exist when it was resolved and columns have been added since.
+/// A column_ref is only valid as long as its category is.
+
+class column_ref
+{
+  public:
+	column_ref(const category &cat, std::string_view column_name)
+		: m_category(&cat)
+		, m_name(column_name)
+	{
+		resolve();
+	}
+
+	/// \brief The index of the column in the category
+	uint16_t index() const
+	{
+		if (m_column_layout != m_category->m_column_layout or
+			(m_ix == m_column_count and m_category->m_columns.size() != m_column_count))
+			resolve();
+		return m_ix;
+	}
+
+	/// \brief Return whether the category contains this column
+	bool exists() const
+	{
+		return index() < m_column_count;
+	}
+
+	const std::string &name() const
+	{
+		return m_name;
+	}
+
+	const category &get_category() const
+	{
+		return *m_category;
+	}
+
+  private:
+	void resolve() const
+	{
+		m_ix = m_category->get_column_ix(m_name);
+		m_column_count = static_cast<uint16_t>(m_category->m_columns.size());
+		m_column_layout = m_category->m_column_layout;
+	}
+
+	const category *m_category;
+	std::string m_name;
+	mutable uint16_t m_ix = 0, m_column_count = 0;
+	mutable uint32_t m_column_layout = 0;
+};
+
+/// \brief A column_ref that returns the value of the column as a \a T
+
+template <typename T>
+class column_handle : public column_ref
+{
+  public:
+	using column_ref::column_ref;
+
+	T operator()(row_handle r) const
+	{
+		return r[index()].template as<T>();
+	}
 };
 
+inline item_handle row_handle::operator[](const column_ref &column)
+{
+	assert(empty() or m_category == &column.get_category());
+	return operator[](column.index());
+}
+
+inline const item_handle row_handle::operator[](const column_ref &column) const
+{
+	assert(empty() or m_category == &column.get_category());
+	return operator[](column.index());
+}
+
 } // namespace cif
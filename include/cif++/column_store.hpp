@@ -0,0 +1,141 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cif++/category.hpp"
+
+#include <span>
+#include <string>
+#include <vector>
+
+/// \file column_store.hpp
+/// This file contains the definition of column_store, a copy of the data
+/// in a category stored per column. Scanning a single column is much faster
+/// this way than accessing the items row by row.
+
+namespace cif
+{
+
+// --------------------------------------------------------------------
+/// \brief The text of all values of a single column, stored in one buffer.
+///
+/// Values that are missing in a row are stored as empty strings.
+
+class text_column
+{
+  public:
+	/// \brief The number of values, equal to the number of rows
+	std::size_t size() const
+	{
+		return m_offsets.size() - 1;
+	}
+
+	/// \brief Return the value for row \a ix
+	std::string_view operator[](std::size_t ix) const
+	{
+		assert(ix + 1 < m_offsets.size());
+		return { m_text.data() + m_offsets[ix], m_offsets[ix + 1] - m_offsets[ix] };
+	}
+
+	/// \brief The concatenated text of all values
+	std::string_view text() const
+	{
+		return m_text;
+	}
+
+	/// \brief The offsets of the values in text(), value ix runs from
+	/// offsets()[ix] to offsets()[ix + 1]
+	std::span<const std::size_t> offsets() const
+	{
+		return m_offsets;
+	}
+
+  private:
+	friend class column_store;
+
+	std::string m_text;
+	std::vector<std::size_t> m_offsets{ 0 };
+};
+
+// --------------------------------------------------------------------
+/// \brief A copy of the data in a category, stored per column.
+///
+/// Use category::get_column_store to obtain the column_store for a
+/// category. It remains valid until the category is modified. The values
+/// of numeric columns are also available as an array of doubles. Numeric
+/// columns are those having type Numb according to the dictionary, or when
+/// there is no dictionary, the columns in which all values are numbers.
+
+class column_store
+{
+  public:
+	column_store(const category &cat);
+
+	column_store(const column_store &) = delete;
+	column_store &operator=(const column_store &) = delete;
+
+	/// \brief The number of rows
+	std::size_t size() const
+	{
+		return m_size;
+	}
+
+	/// \brief Return the text column for \a column_name, throws
+	/// std::out_of_range if the category has no such column
+	const text_column &text(std::string_view column_name) const
+	{
+		return m_columns[get_column_ix(column_name)].m_text;
+	}
+
+	/// \brief Return whether \a column_name is a numeric column
+	bool is_numeric(std::string_view column_name) const
+	{
+		return m_columns[get_column_ix(column_name)].m_numeric;
+	}
+
+	/// \brief Return the values of numeric column \a column_name. Values
+	/// that are missing, null or unknown are stored as NaN. Throws
+	/// std::out_of_range if the category has no such column and
+	/// std::invalid_argument if it is not numeric.
+	std::span<const double> numbers(std::string_view column_name) const;
+
+  private:
+	std::size_t get_column_ix(std::string_view column_name) const;
+
+	struct column
+	{
+		std::string m_name;
+		text_column m_text;
+		bool m_numeric = false;
+		std::vector<double> m_numbers;
+	};
+
+	std::vector<column> m_columns;
+	std::size_t m_size = 0;
+};
+
+} // namespace cif
@@ -28,9 +28,13 @@
 
 #include "cif++/row.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <regex>
 #include <utility>
 
@@ -44,11 +48,133 @@ iset get_category_fields(const category &cat);
 uint16_t get_column_ix(const category &cat, std::string_view col);
 bool is_column_type_uchar(const category &cat, std::string_view col);
 
+/// \brief Statistics on the values in a column of a category, see
+/// category::get_column_statistics
+
+struct column_statistics
+{
+	double m_distinct = 0; ///< The estimated number of distinct values, not counting empty values
+	double m_empty = 0;    ///< The fraction of rows with an empty value
+
+	/// \brief The fraction of rows expected to have a value equal to some value
+	double equal_fraction() const
+	{
+		return m_distinct > 0 ? (1 - m_empty) / m_distinct : 0;
+	}
+};
+
+column_statistics get_column_statistics(const category &cat, uint16_t column);
+
 // --------------------------------------------------------------------
 // some more templates to be able to do querying
 
 namespace detail
 {
+	/// \brief A range of numbers a column is compared with, used to find
+	/// rows in a secondary index. The bounds are inclusive and may be wider
+	/// than the comparison itself, the rows found are tested afterwards.
+
+	struct index_range
+	{
+		double m_lower = -std::numeric_limits<double>::infinity();
+		double m_upper = std::numeric_limits<double>::infinity();
+
+		// rows with a value that is not a number compare as larger
+		bool m_not_a_number = false;
+
+		// the values are parsed as integers rather than as doubles
+		bool m_integral = false;
+	};
+
+	/// \brief The tests on single columns of a condition that can be
+	/// answered by a secondary index, see condition_impl::collect_index_terms
+
+	struct index_terms
+	{
+		// column, value and whether empty values match as well. An empty
+		// value only matches empty values.
+		std::vector<std::tuple<uint16_t, std::string_view, bool>> m_equals;
+		std::vector<std::tuple<uint16_t, index_range>> m_ranges;
+	};
+
+	/// \brief Return the range for a comparison of a column with \a v,
+	/// \a lower is true if \a v is the lower bound (operators > and >=).
+
+	template <typename T>
+	std::optional<index_range> make_index_range(const T &v, bool lower)
+	{
+		std::optional<index_range> result;
+
+		// Integers are parsed with from_chars, numbers with a fraction would
+		// be truncated. Ranges for integers are therefore only used for
+		// columns containing integers, that fit in the smallest type allowed.
+		if constexpr (std::is_floating_point_v<T> or
+					  (std::is_integral_v<T> and std::is_signed_v<T> and sizeof(T) >= 4 and not std::is_same_v<T, bool>))
+		{
+			if (not std::isnan(static_cast<double>(v)))
+			{
+				double bound = static_cast<double>(v);
+
+				// make sure rounding does not exclude any value
+				if constexpr (std::is_same_v<T, float>)
+					bound = std::nextafter(v, lower ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity());
+				else if constexpr (std::is_floating_point_v<T> and not std::is_same_v<T, double>)
+					bound = std::nextafter(bound, lower ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity());
+
+				result = index_range{};
+				(lower ? result->m_lower : result->m_upper) = bound;
+				result->m_not_a_number = lower;
+				result->m_integral = std::is_integral_v<T>;
+			}
+		}
+
+		return result;
+	}
+
+	/// \brief A comparison of a column with a floating point number, that can
+	/// be evaluated using the numbers cached in the rows. Values that are not a
+	/// number compare as larger.
+
+	struct number_comparison
+	{
+		double m_value = 0;
+
+		// compare the values as float instead of double
+		bool m_float = false;
+
+		// whether the row matches if its value is less, equal or greater
+		bool m_less = false, m_equal = false, m_greater = false;
+	};
+
+	/// \brief Return the number_comparison for comparing a column with \a v,
+	/// if it can be evaluated this way
+
+	template <typename T>
+	std::optional<number_comparison> make_number_comparison(const T &v, bool less, bool equal, bool greater)
+	{
+		if constexpr (std::is_same_v<T, double> or std::is_same_v<T, float>)
+			return number_comparison{ static_cast<double>(v), std::is_same_v<T, float>, less, equal, greater };
+		else
+			return {};
+	}
+
+	/// \brief A value bound to a parameter, see prepared_query. Values bound
+	/// as numbers are compared as numbers, others as text, just like the
+	/// values in a condition without parameters.
+
+	struct bound_value
+	{
+		std::string m_text;
+
+		// the value, if a number was bound
+		std::optional<double> m_number;
+		bool m_float = false;
+	};
+
+	/// \brief Return the value bound to parameter \a index, throws
+	/// std::out_of_range if there is none
+	const bound_value &parameter_value(const std::vector<bound_value> &values, size_t index);
+
 	struct condition_impl
 	{
 		virtual ~condition_impl() {}
@@ -59,17 +185,137 @@ namespace detail
 		virtual std::optional<row_handle> single() const { return {}; };
 
 		virtual bool equals([[maybe_unused]] const condition_impl *rhs) const { return false; }
+
+		// Estimates used to plan the evaluation, valid after prepare: the
+		// fraction of the rows that match and the relative cost of a test
+		virtual double selectivity() const { return 0.5; }
+		virtual double cost() const { return 1; }
+
+		// Add the tests of this prepared condition that must hold for a row
+		// to match and that can be answered using a secondary index to \a terms
+		virtual void collect_index_terms([[maybe_unused]] index_terms &terms) const {}
+
+		// Set the values for the parameters in this prepared condition,
+		// see prepared_query
+		virtual void bind([[maybe_unused]] const category &c, [[maybe_unused]] const std::vector<bound_value> &values) {}
+
+		// Add the sets of tests of which at least one must hold for a row
+		// to match to \a alternatives, returns false if there are none
+		virtual bool collect_index_alternatives(std::vector<index_terms> &alternatives) const
+		{
+			index_terms terms;
+			collect_index_terms(terms);
+
+			if (terms.m_equals.empty() and terms.m_ranges.empty())
+				return false;
+
+			alternatives.emplace_back(std::move(terms));
+			return true;
+		}
 	};
 
 	struct all_condition_impl : public condition_impl
 	{
 		bool test(row_handle) const override { return true; }
 		void str(std::ostream &os) const override { os << "*"; }
+
+		double selectivity() const override { return 1; }
+		double cost() const override { return 0; }
 	};
 
 	struct or_condition_impl;
 	struct and_condition_impl;
 	struct not_condition_impl;
+
+	/// \brief A prepared condition lowered into a flat program, that is
+	/// evaluated for a batch of rows at once and results in a bitmap with
+	/// the rows that match.
+	///
+	/// Tests on a single column are evaluated by kernels that first gather
+	/// the values of the rows in a batch and then compare them in a loop
+	/// without branches. Other tests call condition_impl::test for the rows
+	/// that are still selected. AND, OR and NOT only evaluate their operands
+	/// for the rows that can still change the outcome.
+
+	class condition_program
+	{
+	  public:
+		static constexpr size_t kBatchSize = 1024;
+
+		/// \brief Conditions are only compiled for categories with at least this many rows
+		static constexpr size_t kMinRows = 64;
+
+		/// \brief A bitmap with a bit for each row in a batch
+		using selection = std::array<uint64_t, kBatchSize / 64>;
+
+		condition_program(const category &cat, const condition_impl *impl);
+
+		condition_program(const condition_program &) = delete;
+		condition_program &operator=(const condition_program &) = delete;
+
+		/// \brief Store up to kBatchSize rows, starting at \a r, in \a rows.
+		/// Returns the number of rows stored.
+		static size_t fill(const row *r, const row *rows[kBatchSize]);
+
+		/// \brief Set the bits in \a sel for the first \a n rows in \a rows
+		/// that match, clear the others
+		void evaluate(const row *const rows[], size_t n, selection &sel) const;
+
+		/// \brief Return the first row starting at \a r that matches, or
+		/// nullptr. The batch evaluated is kept, to find the next match in it
+		/// as long as the category is not modified. Not thread safe.
+		const row *find_next(const row *r) const;
+
+		/// \brief Return the number of rows starting at \a r that match
+		size_t count(const row *r) const;
+
+		/// \brief Take over the values compared with from the condition
+		/// after new values were bound to its parameters
+		void bind();
+
+	  private:
+		struct instruction
+		{
+			enum class kind : uint8_t
+			{
+				all,
+				test,
+				equals,
+				equals_or_empty,
+				empty,
+				not_empty,
+				number,
+				op_and,
+				op_or,
+				op_not
+			} m_kind;
+
+			// the index of the next instruction that is not an operand of this one
+			size_t m_end = 0;
+
+			uint16_t m_column = 0;
+			bool m_icase = false;
+			std::string_view m_value;
+			const std::vector<bool> *m_interned = nullptr;
+			number_comparison m_number;
+			const condition_impl *m_impl = nullptr;
+		};
+
+		void compile(const condition_impl *impl);
+
+		// evaluate the instruction at \a ix, clearing the bits in \a sel
+		// for the rows that do not match
+		void evaluate(size_t ix, const row *const rows[], size_t n, selection &sel) const;
+
+		const category &m_category;
+		std::vector<instruction> m_code;
+
+		// the batch last evaluated by find_next
+		mutable std::vector<const row *> m_batch;
+		mutable selection m_batch_selection;
+		mutable size_t m_batch_size = 0, m_batch_next = 0;
+		mutable uint32_t m_batch_generation = 0;
+	};
 } // namespace detail
 
 class condition
@@ -93,6 +339,12 @@ class condition
 		: m_impl(nullptr)
 	{
 		std::swap(m_impl, rhs.m_impl);
+		std::swap(m_prepared, rhs.m_prepared);
+		std::swap(m_candidates, rhs.m_candidates);
+		std::swap(m_candidates_tested, rhs.m_candidates_tested);
+		std::swap(m_plan, rhs.m_plan);
+		std::swap(m_row_count, rhs.m_row_count);
+		std::swap(m_program, rhs.m_program);
 	}
 
 	condition &operator=(const condition &) = delete;
@@ -100,17 +352,31 @@ class condition
 	condition &operator=(condition &&rhs) noexcept
 	{
 		std::swap(m_impl, rhs.m_impl);
+		std::swap(m_prepared, rhs.m_prepared);
+		std::swap(m_candidates, rhs.m_candidates);
+		std::swap(m_candidates_tested, rhs.m_candidates_tested);
+		std::swap(m_plan, rhs.m_plan);
+		std::swap(m_row_count, rhs.m_row_count);
+		std::swap(m_program, rhs.m_program);
 		return *this;
 	}
 
 	~condition()
 	{
+		delete m_program;
+		m_program = nullptr;
 		delete m_impl;
 		m_impl = nullptr;
 	}
 
 	void prepare(const category &c);
 
+	/// \brief Bind \a values to the parameters of this prepared condition
+	/// and choose the access path again. The condition is not prepared
+	/// again, see prepared_query.
+
+	void bind(const category &c, const std::vector<detail::bound_value> &values);
+
 	bool operator()(row_handle r) const
 	{
 		assert(this->m_impl != nullptr);
@@ -121,11 +387,40 @@ class condition
 	explicit operator bool() { return not empty(); }
 	bool empty() const { return m_impl == nullptr; }
 
+	bool prepared() const { return m_prepared; }
+
 	std::optional<row_handle> single() const
 	{
 		return m_impl ? m_impl->single() : std::optional<row_handle>();
 	}
 
+	/// \brief If prepare could use a secondary index of the category, return
+	/// the rows found. All rows that match are in this list, in the order of
+	/// the category, but they should still be tested. Returns nullptr if no
+	/// index was used.
+
+	const std::vector<row *> *candidates() const
+	{
+		return m_candidates.has_value() ? &*m_candidates : nullptr;
+	}
+
+	/// \brief Return whether candidate \a r matches. Candidates found by
+	/// testing all rows in parallel, see category::find, are not tested again.
+
+	bool candidate_matches(row_handle r) const
+	{
+		return m_candidates_tested or operator()(r);
+	}
+
+	/// \brief If all rows of the category need to be tested and there are
+	/// enough of them, prepare compiles the condition into a program that
+	/// tests rows in batches. Returns nullptr if there is none.
+
+	const detail::condition_program *program() const
+	{
+		return m_program;
+	}
+
 	friend condition operator||(condition &&a, condition &&b);
 	friend condition operator&&(condition &&a, condition &&b);
 
@@ -133,24 +428,64 @@ class condition
 	friend struct detail::and_condition_impl;
 	friend struct detail::not_condition_impl;
 
+	friend class category;
+
 	void swap(condition &rhs)
 	{
 		std::swap(m_impl, rhs.m_impl);
 		std::swap(m_prepared, rhs.m_prepared);
+		std::swap(m_candidates, rhs.m_candidates);
+		std::swap(m_candidates_tested, rhs.m_candidates_tested);
+		std::swap(m_plan, rhs.m_plan);
+		std::swap(m_row_count, rhs.m_row_count);
+		std::swap(m_program, rhs.m_program);
+	}
+
+	/// \brief Write the condition to \a os. Once prepared, this is
+	/// preceded by the way the rows are found, the access path, and the
+	/// estimated number of rows. The sub conditions are listed in the
+	/// order in which they are tested, e.g.:
+	///
+	///     INDEX atom_site(label_asym_id, label_seq_id), 24 candidates, ~8 of 1000 rows: (label_asym_id == A AND label_seq_id > 10 AND ...)
+
+	void str(std::ostream &os) const
+	{
+		if (m_impl and m_prepared and not m_plan.empty())
+		{
+			os << m_plan;
+			if (m_candidates.has_value())
+				os << ", " << m_candidates->size() << " candidates";
+			os << ", ~" << std::lround(m_impl->selectivity() * m_row_count) << " of " << m_row_count << " rows: ";
+		}
+
+		if (m_impl)
+			m_impl->str(os);
 	}
 
 	friend std::ostream &operator<<(std::ostream &os, const condition &cond)
 	{
-		if (cond.m_impl)
-			cond.m_impl->str(os);
+		cond.str(os);
 		return os;
 	}
 
   private:
 	void optimise(condition_impl *&impl);
 
+	// choose the access path for the prepared condition
+	void plan(const category &c);
+
 	condition_impl *m_impl;
 	bool m_prepared = false;
+	std::optional<std::vector<row *>> m_candidates;
+
+	// the candidates are exactly the rows that match
+	bool m_candidates_tested = false;
+
+	// the access path chosen by prepare and the number of rows, for str
+	std::string m_plan;
+	size_t m_row_count = 0;
+
+	detail::condition_program *m_program = nullptr;
 };
 
 namespace detail
@@ -165,6 +500,7 @@ namespace detail
 		condition_impl *prepare(const category &c) override
 		{
 			m_item_ix = get_column_ix(c, m_item_tag);
+			m_selectivity = get_column_statistics(c, m_item_ix).m_empty;
 			return this;
 		}
 
@@ -173,13 +509,22 @@ namespace detail
 			return r[m_item_ix].empty();
 		}
 
+		double selectivity() const override { return m_selectivity; }
+		double cost() const override { return 0.5; }
+
 		void str(std::ostream &os) const override
 		{
 			os << m_item_tag << " IS NULL";
 		}
 
+		void collect_index_terms(index_terms &terms) const override
+		{
+			terms.m_equals.emplace_back(m_item_ix, std::string_view{}, true);
+		}
+
 		std::string m_item_tag;
 		uint16_t m_item_ix = 0;
+		double m_selectivity = 0.5;
 	};
 
 	struct key_is_not_empty_condition_impl : public condition_impl
@@ -192,6 +537,7 @@ namespace detail
 		condition_impl *prepare(const category &c) override
 		{
 			m_item_ix = get_column_ix(c, m_item_tag);
+			m_selectivity = 1 - get_column_statistics(c, m_item_ix).m_empty;
 			return this;
 		}
 
@@ -205,8 +551,12 @@ namespace detail
 			os << m_item_tag << " IS NOT NULL";
 		}
 
+		double selectivity() const override { return m_selectivity; }
+		double cost() const override { return 0.5; }
+
 		std::string m_item_tag;
 		uint16_t m_item_ix = 0;
+		double m_selectivity = 0.5;
 	};
 
 	struct key_equals_condition_impl : public condition_impl
@@ -217,16 +567,43 @@ namespace detail
 		{
 		}
 
+		key_equals_condition_impl(size_t parameter, const std::string &item_tag)
+			: m_item_tag(item_tag)
+			, m_parameter(parameter)
+		{
+		}
+
 		condition_impl *prepare(const category &c) override;
 
+		void bind(const category &c, const std::vector<bound_value> &values) override;
+
 		bool test(row_handle r) const override
 		{
-			return m_single_hit.has_value() ? *m_single_hit == r : r[m_item_ix].compare(m_value, m_icase) == 0;
+			if (m_single_hit.has_value())
+				return *m_single_hit == r;
+
+			if (m_null)
+				return r[m_item_ix].empty();
+
+			// interned values are compared by id, values added after
+			// prepare have a new id and are compared by text
+			if (not m_interned_matches.empty())
+			{
+				auto id = r[m_item_ix].interned_id();
+				if (id < m_interned_matches.size())
+					return m_interned_matches[id];
+			}
+
+			return r[m_item_ix].compare(m_value, m_icase) == 0;
 		}
 
 		void str(std::ostream &os) const override
 		{
-			os << m_item_tag << (m_icase ? "^ " : " ") << " == " << m_value;
+			os << m_item_tag << (m_icase ? "^ " : " ") << " == ";
+			if (m_parameter.has_value())
+				os << '$' << *m_parameter;
+			else
+				os << m_value;
 		}
 
 		virtual std::optional<row_handle> single() const override
@@ -234,12 +611,23 @@ namespace detail
 			return m_single_hit;
 		}
 
+		void collect_index_terms(index_terms &terms) const override
+		{
+			if (not m_null)
+				terms.m_equals.emplace_back(m_item_ix, m_value, false);
+		}
+
+		double selectivity() const override { return m_selectivity; }
+		double cost() const override { return m_single_hit.has_value() or not m_interned_matches.empty() ? 0.5 : 1; }
+
 		virtual bool equals(const condition_impl *rhs) const override
 		{
 			if (typeid(*rhs) == typeid(key_equals_condition_impl))
 			{
 				auto ri = static_cast<const key_equals_condition_impl *>(rhs);
-				if (m_single_hit.has_value() or ri->m_single_hit.has_value())
+				if (m_parameter.has_value() or ri->m_parameter.has_value())
+					return m_parameter == ri->m_parameter and m_item_ix == ri->m_item_ix and m_item_tag == ri->m_item_tag;
+				else if (m_single_hit.has_value() or ri->m_single_hit.has_value())
 					return m_single_hit == ri->m_single_hit;
 				else
 					// watch out, both m_item_ix might be the same while tags might be diffent (in case they both do not exist in the category)
@@ -253,6 +641,21 @@ namespace detail
 		bool m_icase = false;
 		std::string m_value;
 		std::optional<row_handle> m_single_hit;
+		double m_selectivity = 0.5;
+
+		// for interned columns, whether the value with an id matches
+		std::vector<bool> m_interned_matches;
+
+		// the parameter m_value is bound to, if any
+		std::optional<size_t> m_parameter;
+
+		// an empty text was bound to m_parameter, rows with an empty
+		// value match, like with (key == cif::null)
+		bool m_null = false;
+
+	  private:
+		// look up the rows for m_value
+		void lookup(const category &c);
 	};
 
 	struct key_equals_or_empty_condition_impl : public condition_impl
@@ -262,6 +665,7 @@ namespace detail
 			, m_value(equals->m_value)
 			, m_icase(equals->m_icase)
 			, m_single_hit(equals->m_single_hit)
+			, m_parameter(equals->m_parameter)
 		{
 		}
 
@@ -269,9 +673,19 @@ namespace detail
 		{
 			m_item_ix = get_column_ix(c, m_item_tag);
 			m_icase = is_column_type_uchar(c, m_item_tag);
+
+			auto stats = get_column_statistics(c, m_item_ix);
+			m_selectivity = stats.equal_fraction() + stats.m_empty;
+
 			return this;
 		}
 
+		void bind([[maybe_unused]] const category &c, const std::vector<bound_value> &values) override
+		{
+			if (m_parameter.has_value())
+				m_value = parameter_value(values, *m_parameter).m_text;
+		}
+
 		bool test(row_handle r) const override
 		{
 			bool result = false;
@@ -284,9 +698,22 @@ namespace detail
 
 		void str(std::ostream &os) const override
 		{
-			os << '(' << m_item_tag << (m_icase ? "^ " : " ") << " == " << m_value << " OR " << m_item_tag << " IS NULL)";
+			os << '(' << m_item_tag << (m_icase ? "^ " : " ") << " == ";
+			if (m_parameter.has_value())
+				os << '$' << *m_parameter;
+			else
+				os << m_value;
+			os << " OR " << m_item_tag << " IS NULL)";
+		}
+
+		void collect_index_terms(index_terms &terms) const override
+		{
+			terms.m_equals.emplace_back(m_item_ix, m_value, true);
 		}
 
+		double selectivity() const override { return m_selectivity; }
+		double cost() const override { return 1.5; }
+
 		virtual std::optional<row_handle> single() const override
 		{
 			return m_single_hit;
@@ -297,7 +724,9 @@ namespace detail
 			if (typeid(*rhs) == typeid(key_equals_or_empty_condition_impl))
 			{
 				auto ri = static_cast<const key_equals_or_empty_condition_impl *>(rhs);
-				if (m_single_hit.has_value() or ri->m_single_hit.has_value())
+				if (m_parameter.has_value() or ri->m_parameter.has_value())
+					return m_parameter == ri->m_parameter and m_item_ix == ri->m_item_ix and m_item_tag == ri->m_item_tag;
+				else if (m_single_hit.has_value() or ri->m_single_hit.has_value())
 					return m_single_hit == ri->m_single_hit;
 				else
 					// watch out, both m_item_ix might be the same while tags might be diffent (in case they both do not exist in the category)
@@ -311,15 +740,30 @@ namespace detail
 		std::string m_value;
 		bool m_icase = false;
 		std::optional<row_handle> m_single_hit;
+		double m_selectivity = 0.5;
+		std::optional<size_t> m_parameter;
 	};
 
 	struct key_compare_condition_impl : public condition_impl
 	{
 		template <typename COMP>
-		key_compare_condition_impl(const std::string &item_tag, COMP &&comp, const std::string &s)
+		key_compare_condition_impl(const std::string &item_tag, COMP &&comp, const std::string &s,
+			std::optional<index_range> range = {}, std::optional<number_comparison> number = {})
 			: m_item_tag(item_tag)
 			, m_compare(std::move(comp))
 			, m_str(s)
+			, m_range(range)
+			, m_number(number)
+		{
+		}
+
+		// A comparison with the value bound to \a parameter, \a number
+		// tells which comparison
+		key_compare_condition_impl(const std::string &item_tag, size_t parameter, const std::string &s, number_comparison number)
+			: m_item_tag(item_tag)
+			, m_str(s)
+			, m_number(number)
+			, m_parameter(parameter)
 		{
 		}
 
@@ -332,19 +776,77 @@ namespace detail
 
 		bool test(row_handle r) const override
 		{
+			if (m_parameter.has_value())
+			{
+				int d;
+				if (m_text.has_value())
+					d = r[m_item_ix].compare(std::string_view(*m_text), m_icase);
+				else if (m_number->m_float)
+					d = r[m_item_ix].compare(static_cast<float>(m_number->m_value), m_icase);
+				else
+					d = r[m_item_ix].compare(m_number->m_value, m_icase);
+				return d < 0 ? m_number->m_less : d == 0 ? m_number->m_equal : m_number->m_greater;
+			}
+
 			return m_compare(r, m_icase);
 		}
 
+		void bind([[maybe_unused]] const category &c, const std::vector<bound_value> &values) override
+		{
+			if (not m_parameter.has_value())
+				return;
+
+			auto &value = parameter_value(values, *m_parameter);
+			if (value.m_number.has_value())
+			{
+				m_text.reset();
+				m_number->m_value = *value.m_number;
+				m_number->m_float = value.m_float;
+				m_range = value.m_float
+				              ? make_index_range(static_cast<float>(*value.m_number), m_number->m_greater)
+				              : make_index_range(*value.m_number, m_number->m_greater);
+			}
+			else
+			{
+				m_text = value.m_text;
+				m_range.reset();
+			}
+		}
+
 		void str(std::ostream &os) const override
 		{
 			os << m_item_tag << (m_icase ? "^ " : " ") << m_str;
 		}
 
+		void collect_index_terms(index_terms &terms) const override
+		{
+			if (m_range.has_value())
+				terms.m_ranges.emplace_back(m_item_ix, *m_range);
+		}
+
+		// values are parsed for each test, there are no statistics on them
+		double selectivity() const override { return 1.0 / 3; }
+		double cost() const override { return 2; }
+
 		std::string m_item_tag;
 		uint16_t m_item_ix = 0;
 		bool m_icase = false;
 		std::function<bool(row_handle, bool)> m_compare;
 		std::string m_str;
+
+		// for comparisons with numbers, the range of values that may match
+		std::optional<index_range> m_range;
+
+		// for comparisons with floating point numbers, the same comparison
+		// to be evaluated by a condition_program
+		std::optional<number_comparison> m_number;
+
+		// the parameter compared with, if any. The comparison is in
+		// m_number, the value as well if a number was bound
+		std::optional<size_t> m_parameter;
+
+		// the text bound to m_parameter, if it was not a number
+		std::optional<std::string> m_text;
 	};
 
 	struct key_matches_condition_impl : public condition_impl
@@ -373,6 +875,9 @@ namespace detail
 			os << m_item_tag << " =~ expression";
 		}
 
+		double selectivity() const override { return 0.25; }
+		double cost() const override { return 10; }
+
 		std::string m_item_tag;
 		uint16_t m_item_ix;
 		std::regex mRx;
@@ -388,8 +893,10 @@ namespace detail
 		{
 		}
 
-		bool test(row_handle r) const override
+		bool test(row_handle rh) const override
 		{
+			// read only access, conditions may be tested on multiple threads
+			const row_handle &r = rh;
 			auto &c = r.get_category();
 
 			bool result = false;
@@ -416,6 +923,9 @@ namespace detail
 			os << "<any> == " << mValue;
 		}
 
+		double selectivity() const override { return 0.1; }
+		double cost() const override { return 20; }
+
 		valueType mValue;
 	};
 
@@ -426,8 +936,10 @@ namespace detail
 		{
 		}
 
-		bool test(row_handle r) const override
+		bool test(row_handle rh) const override
 		{
+			// read only access, conditions may be tested on multiple threads
+			const row_handle &r = rh;
 			auto &c = r.get_category();
 
 			bool result = false;
@@ -455,6 +967,9 @@ namespace detail
 			os << "<any> =~ expression";
 		}
 
+		double selectivity() const override { return 0.25; }
+		double cost() const override { return 50; }
+
 		std::regex mRx;
 	};
 
@@ -498,9 +1013,34 @@ namespace detail
 		{
 			for (auto &sub : m_sub)
 				sub = sub->prepare(c);
+
+			// Test the cheapest and most selective sub conditions first
+			order_subs(m_sub, [](double cost, double selectivity)
+				{ return selectivity < 1 ? cost / (1 - selectivity) : std::numeric_limits<double>::infinity(); });
+
 			return this;
 		}
 
+		double selectivity() const override
+		{
+			double result = 1;
+			for (auto sub : m_sub)
+				result *= sub->selectivity();
+			return result;
+		}
+
+		// A sub condition is only tested if the previous ones matched
+		double cost() const override
+		{
+			double result = 0, tested = 1;
+			for (auto sub : m_sub)
+			{
+				result += tested * sub->cost();
+				tested *= sub->selectivity();
+			}
+			return result;
+		}
+
 		bool test(row_handle r) const override
 		{
 			bool result = true;
@@ -559,8 +1099,35 @@ namespace detail
 			return result;
 		}
 
+		void collect_index_terms(index_terms &terms) const override
+		{
+			for (auto sub : m_sub)
+				sub->collect_index_terms(terms);
+		}
+
+		void bind(const category &c, const std::vector<bound_value> &values) override
+		{
+			for (auto sub : m_sub)
+				sub->bind(c, values);
+		}
+
 		static condition_impl *combine_equal(std::vector<and_condition_impl *> &subs, or_condition_impl *oc);
 
+		// Sort \a subs on the rank returned by \a rank for their cost and selectivity
+		template <typename Rank>
+		static void order_subs(std::vector<condition_impl *> &subs, Rank &&rank)
+		{
+			std::vector<std::tuple<double, condition_impl *>> ranked;
+			for (auto sub : subs)
+				ranked.emplace_back(rank(sub->cost(), sub->selectivity()), sub);
+
+			std::stable_sort(ranked.begin(), ranked.end(),
+				[](auto &a, auto &b) { return std::get<0>(a) < std::get<0>(b); });
+
+			for (size_t i = 0; i < subs.size(); ++i)
+				subs[i] = std::get<1>(ranked[i]);
+		}
+
 		std::vector<condition_impl *> m_sub;
 	};
 
@@ -628,6 +1195,43 @@ namespace detail
 			os << ')';
 		}
 
+		double selectivity() const override
+		{
+			double result = 1;
+			for (auto sub : m_sub)
+				result *= 1 - sub->selectivity();
+			return 1 - result;
+		}
+
+		// A sub condition is only tested if the previous ones did not match
+		double cost() const override
+		{
+			double result = 0, tested = 1;
+			for (auto sub : m_sub)
+			{
+				result += tested * sub->cost();
+				tested *= 1 - sub->selectivity();
+			}
+			return result;
+		}
+
+		bool collect_index_alternatives(std::vector<index_terms> &alternatives) const override
+		{
+			for (auto sub : m_sub)
+			{
+				if (not sub->collect_index_alternatives(alternatives))
+					return false;
+			}
+
+			return true;
+		}
+
+		void bind(const category &c, const std::vector<bound_value> &values) override
+		{
+			for (auto sub : m_sub)
+				sub->bind(c, values);
+		}
+
 		virtual std::optional<row_handle> single() const override
 		{
 			std::optional<row_handle> result;
@@ -686,6 +1290,14 @@ namespace detail
 			os << ')';
 		}
 
+		double selectivity() const override { return 1 - mA->selectivity(); }
+		double cost() const override { return mA->cost(); }
+
+		void bind(const category &c, const std::vector<bound_value> &values) override
+		{
+			mA->bind(c, values);
+		}
+
 		condition_impl *mA;
 	};
 
@@ -740,6 +1352,19 @@ struct empty_type
 
 inline constexpr empty_type null = empty_type();
 
+/// \brief A placeholder for a value that is bound later, see prepared_query.
+/// E.g. ("label_asym_id"_key == cif::parameter(0) and "label_seq_id"_key == cif::parameter(1))
+
+struct parameter
+{
+	explicit constexpr parameter(size_t index)
+		: m_index(index)
+	{
+	}
+
+	size_t m_index;
+};
+
 struct key
 {
 	explicit key(const std::string &itemTag)
@@ -800,9 +1425,9 @@ condition operator>(const key &key, const T &v)
 	s << " > " << v;
 
 	return condition(new detail::key_compare_condition_impl(
-		key.m_item_tag, [tag = key.m_item_tag, v](row_handle r, bool icase)
+		key.m_item_tag, [tag = key.m_item_tag, v](const row_handle &r, bool icase)
 		{ return r[tag].template compare<T>(v, icase) > 0; },
-		s.str()));
+		s.str(), detail::make_index_range(v, true), detail::make_number_comparison(v, false, false, true)));
 }
 
 template <typename T>
@@ -812,9 +1437,9 @@ condition operator>=(const key &key, const T &v)
 	s << " >= " << v;
 
 	return condition(new detail::key_compare_condition_impl(
-		key.m_item_tag, [tag = key.m_item_tag, v](row_handle r, bool icase)
+		key.m_item_tag, [tag = key.m_item_tag, v](const row_handle &r, bool icase)
 		{ return r[tag].template compare<T>(v, icase) >= 0; },
-		s.str()));
+		s.str(), detail::make_index_range(v, true), detail::make_number_comparison(v, false, true, true)));
 }
 
 template <typename T>
@@ -824,9 +1449,9 @@ condition operator<(const key &key, const T &v)
 	s << " < " << v;
 
 	return condition(new detail::key_compare_condition_impl(
-		key.m_item_tag, [tag = key.m_item_tag, v](row_handle r, bool icase)
+		key.m_item_tag, [tag = key.m_item_tag, v](const row_handle &r, bool icase)
 		{ return r[tag].template compare<T>(v, icase) < 0; },
-		s.str()));
+		s.str(), detail::make_index_range(v, false), detail::make_number_comparison(v, true, false, false)));
 }
 
 template <typename T>
@@ -836,9 +1461,42 @@ condition operator<=(const key &key, const T &v)
 	s << " <= " << v;
 
 	return condition(new detail::key_compare_condition_impl(
-		key.m_item_tag, [tag = key.m_item_tag, v](row_handle r, bool icase)
+		key.m_item_tag, [tag = key.m_item_tag, v](const row_handle &r, bool icase)
 		{ return r[tag].template compare<T>(v, icase) <= 0; },
-		s.str()));
+		s.str(), detail::make_index_range(v, false), detail::make_number_comparison(v, true, true, false)));
+}
+
+inline condition operator==(const key &key, const parameter &p)
+{
+	return condition(new detail::key_equals_condition_impl(p.m_index, key.m_item_tag));
+}
+
+inline condition operator!=(const key &key, const parameter &p)
+{
+	return condition(new detail::not_condition_impl(operator==(key, p)));
+}
+
+// Values bound to parameters are compared as numbers if they are numbers,
+// as text otherwise, see detail::bound_value
+
+inline condition operator>(const key &key, const parameter &p)
+{
+	return condition(new detail::key_compare_condition_impl(key.m_item_tag, p.m_index, " > $" + std::to_string(p.m_index), { 0, false, false, false, true }));
+}
+
+inline condition operator>=(const key &key, const parameter &p)
+{
+	return condition(new detail::key_compare_condition_impl(key.m_item_tag, p.m_index, " >= $" + std::to_string(p.m_index), { 0, false, false, true, true }));
+}
+
+inline condition operator<(const key &key, const parameter &p)
+{
+	return condition(new detail::key_compare_condition_impl(key.m_item_tag, p.m_index, " < $" + std::to_string(p.m_index), { 0, false, true, false, false }));
+}
+
+inline condition operator<=(const key &key, const parameter &p)
+{
+	return condition(new detail::key_compare_condition_impl(key.m_item_tag, p.m_index, " <= $" + std::to_string(p.m_index), { 0, false, true, true, false }));
 }
 
 inline condition operator==(const key &key, const std::regex &rx)
@@ -66,6 +66,9 @@ class datablock : public std::list<category>
 	bool is_valid() const;
 	bool validate_links() const;
 
+	/// \brief Call category::create_link_indices for all categories
+	void create_link_indices();
+
 	// --------------------------------------------------------------------
 
 	category &operator[](std::string_view name);
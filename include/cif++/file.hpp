@@ -54,16 +54,7 @@ class file : public std::list<datablock>
 
 	explicit file(const char *data, size_t length)
 	{
-		struct membuf : public std::streambuf
-		{
-			membuf(char *text, size_t length)
-			{
-				this->setg(text, text, text + length);
-			}
-		} buffer(const_cast<char *>(data), length);
-
-		std::istream is(&buffer);
-		load(is);
+		load(data, length);
 	}
 
 	file(const file &) = default;
@@ -82,6 +73,16 @@ class file : public std::list<datablock>
 	bool is_valid();
 	bool validate_links() const;
 
+	/// \brief Validate the structure of all categories and all values in
+	/// one batch, using at most \a thread_count threads or the number of
+	/// hardware threads if zero. The work is split across categories and
+	/// across chunks of rows in large categories. Values are not validated
+	/// while a file is loaded, use this after loading to check them.
+	///
+	/// Instead of throwing on the first error, all problems are returned.
+	/// The report is ordered by datablock, category and row.
+	validation_report validate(std::size_t thread_count = 0) const;
+
 	void load_dictionary();
 	void load_dictionary(std::string_view name);
 
@@ -104,8 +105,23 @@ class file : public std::list<datablock>
 
 	std::tuple<iterator, bool> emplace(std::string_view name);
 
-	void load(const std::filesystem::path &p);
-	void load(std::istream &is);
+	/// \brief Load the data from \a p. If \a categories is not empty, only
+	/// the categories named in it are loaded, the values of all other
+	/// categories are skipped while parsing.
+	void load(const std::filesystem::path &p, const iset &categories = {});
+	void load(std::istream &is, const iset &categories = {});
+	void load(const char *data, std::size_t length, const iset &categories = {});
+
+	/// \brief Load the file \a p parsing its datablocks in parallel, using at
+	/// most \a thread_count threads or the number of hardware threads if zero.
+	/// The result is the same as that of load(p). This is useful for files
+	/// containing many datablocks, like the CCD or dictionary bundles.
+	void load_parallel(const std::filesystem::path &p, std::size_t thread_count = 0);
+
+	/// \brief Load the \a length bytes at \a data parsing the datablocks in
+	/// parallel, see above. This has a different name to avoid confusion
+	/// with load_parallel(path, thread_count) when passing a string literal.
+	void load_parallel_buffer(const char *data, std::size_t length, std::size_t thread_count = 0);
 
 	void save(const std::filesystem::path &p) const;
 	void save(std::ostream &os) const;
@@ -117,6 +133,9 @@ class file : public std::list<datablock>
 	}
 
   private:
+	void load(parser &p, const iset &categories);
+	void loaded(const validator *saved);
+
 	const validator *m_validator = nullptr;
 };
 
@@ -35,9 +35,12 @@ namespace cif
 {
 
 class category;
+class column_ref;
+class column_store;
 class datablock;
 class file;
 class parser;
+class prepared_query;
 
 class row;
 class row_handle;
@@ -45,4 +48,9 @@ class row_handle;
 class item;
 struct item_handle;
 
+namespace detail
+{
+	class condition_program;
+} // namespace detail
+
 } // namespace cif
\ No newline at end of file
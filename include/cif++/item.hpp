@@ -31,6 +31,7 @@
 #include "cif++/text.hpp"
 #include "cif++/utilities.hpp"
 
+#include <array>
 #include <cassert>
 #include <charconv>
 #include <cstring>
@@ -39,6 +40,7 @@
 #include <limits>
 #include <memory>
 #include <optional>
+#include <unordered_map>
 #include <utility>
 
 /// \file item.hpp
@@ -180,13 +182,109 @@ class item
 	std::string m_value;
 };
 
+// --------------------------------------------------------------------
+/// \brief storage for the text of item_values too long to be stored inline
+///
+/// Space is handed out from large blocks. Released space is kept in a
+/// free list per size and reused for new values of about the same size.
+/// All space is freed at once when the arena is destroyed. Values longer
+/// than kMaxLength are not stored in the arena. An arena is not thread
+/// safe, use one arena per thread and merge them afterwards.
+
+class string_arena
+{
+  public:
+	static constexpr size_t kMaxLength = 255;
+
+	string_arena() = default;
+	string_arena(string_arena &&) = default;
+	string_arena &operator=(string_arena &&) = default;
+
+	string_arena(const string_arena &) = delete;
+	string_arena &operator=(const string_arena &) = delete;
+
+	/// \brief Return space for \a length characters plus a terminating
+	/// null character, or nullptr if \a length is larger than kMaxLength
+	char *allocate(size_t length);
+
+	/// \brief Release space returned by allocate for \a length characters
+	void deallocate(char *p, size_t length);
+
+	/// \brief Take over the blocks of \a rhs, including the released space
+	void merge(string_arena &&rhs);
+
+  private:
+	static constexpr size_t kBlockSize = 64 * 1024;
+	static constexpr size_t kGranularity = 8;
+
+	static constexpr size_t slot_size(size_t length)
+	{
+		return (length + kGranularity) & ~(kGranularity - 1);
+	}
+
+	std::vector<std::unique_ptr<char[]>> m_blocks;
+	size_t m_used = kBlockSize;
+	std::array<char *, (kMaxLength + kGranularity) / kGranularity + 1> m_free{};
+};
+
+// --------------------------------------------------------------------
+/// \brief A table of unique strings, used to intern the values of columns
+/// that contain only a few distinct values.
+///
+/// Each string is stored once, along with a sequence number, its id. Item
+/// values that are interned all point to the text in this table, so two
+/// interned values are equal if they point to the same text.
+
+class string_table
+{
+  public:
+	static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+	string_table() = default;
+	string_table(const string_table &) = delete;
+	string_table &operator=(const string_table &) = delete;
+
+	/// \brief Return the stored copy of \a text, adding it if needed
+	const char *intern(std::string_view text);
+
+	/// \brief Return the stored copy of \a text or nullptr if there is none
+	const char *find(std::string_view text) const;
+
+	/// \brief The number of strings in this table, ids are less than this
+	uint32_t size() const
+	{
+		return static_cast<uint32_t>(m_entries.size());
+	}
+
+	/// \brief Return the string with id \a id
+	std::string_view operator[](uint32_t id) const
+	{
+		return m_entries[id];
+	}
+
+	/// \brief Return the id of \a text, which must be returned by intern
+	static uint32_t id(const char *text)
+	{
+		uint32_t result;
+		std::memcpy(&result, text - sizeof(uint32_t), sizeof(uint32_t));
+		return result;
+	}
+
+  private:
+	std::vector<std::unique_ptr<char[]>> m_storage;
+	std::vector<std::string_view> m_entries;
+	std::unordered_map<std::string_view, uint32_t> m_index;
+};
+
 // --------------------------------------------------------------------
 /// \brief the internal storage for items in a category
 ///
 /// Internal storage, strictly forward linked list with minimal space
 /// requirements. Strings of size 7 or shorter are stored internally.
 /// Typically, more than 99% of the strings in an mmCIF file are less
-/// than 8 bytes in length.
+/// than 8 bytes in length. Longer strings are stored in the string_arena
+/// of the category when possible, or in a separate allocation otherwise.
+/// Values of interned columns point to the text in a string_table instead.
 
 struct item_value
 {
@@ -194,7 +292,7 @@ struct item_value
 
 	/// \brief constructor
 	item_value(std::string_view text)
-		: m_length(text.length())
+		: m_length(static_cast<uint32_t>(text.length()))
 		, m_storage(0)
 	{
 		if (m_length >= kBufferSize)
@@ -210,8 +308,40 @@ struct item_value
 		}
 	}
 
+	/// \brief constructor storing long text in \a arena
+	item_value(std::string_view text, string_arena &arena)
+		: m_length(static_cast<uint32_t>(text.length()))
+		, m_storage(0)
+	{
+		if (m_length >= kBufferSize)
+		{
+			m_data = arena.allocate(m_length);
+			m_in_arena = m_data != nullptr;
+			if (not m_in_arena)
+				m_data = new char[m_length + 1];
+
+			std::copy(text.begin(), text.end(), m_data);
+			m_data[m_length] = 0;
+		}
+		else
+		{
+			std::copy(text.begin(), text.end(), m_local_data);
+			m_local_data[m_length] = 0;
+		}
+	}
+
+	/// \brief constructor storing \a text in \a table
+	item_value(std::string_view text, string_table &table)
+		: m_length(static_cast<uint32_t>(text.length()))
+		, m_interned(true)
+		, m_data(const_cast<char *>(table.intern(text)))
+	{
+	}
+
 	item_value(item_value &&rhs)
 		: m_length(std::exchange(rhs.m_length, 0))
+		, m_in_arena(std::exchange(rhs.m_in_arena, false))
+		, m_interned(std::exchange(rhs.m_interned, false))
 		, m_storage(std::exchange(rhs.m_storage, 0))
 	{
 	}
@@ -221,6 +351,8 @@ struct item_value
 		if (this != &rhs)
 		{
 			m_length = std::exchange(rhs.m_length, m_length);
+			m_in_arena = std::exchange(rhs.m_in_arena, m_in_arena);
+			m_interned = std::exchange(rhs.m_interned, m_interned);
 			m_storage = std::exchange(rhs.m_storage, m_storage);
 		}
 		return *this;
@@ -228,7 +360,8 @@ struct item_value
 
 	~item_value()
 	{
-		if (m_length >= kBufferSize)
+		// space in an arena or a string_table is freed by its owner
+		if (m_length >= kBufferSize and not (m_in_arena or m_interned))
 			delete[] m_data;
 		m_storage = 0;
 		m_length = 0;
@@ -237,12 +370,31 @@ struct item_value
 	item_value(const item_value &) = delete;
 	item_value &operator=(const item_value &) = delete;
 
+	/// \brief Clear the value, returning its space to \a arena if it was allocated there
+	void release(string_arena &arena)
+	{
+		if (m_length >= kBufferSize and not m_interned)
+		{
+			if (m_in_arena)
+				arena.deallocate(m_data, m_length);
+			else
+				delete[] m_data;
+		}
+
+		m_storage = 0;
+		m_length = 0;
+		m_in_arena = false;
+		m_interned = false;
+	}
+
 	explicit operator bool() const
 	{
 		return m_length != 0;
 	}
 
-	size_t m_length = 0;
+	uint32_t m_length = 0;
+	bool m_in_arena = false;
+	bool m_interned = false;
 	union
 	{
 		char m_local_data[8];
@@ -256,7 +408,13 @@ struct item_value
 	// nice performance gain since we avoid many calls to strlen.
 	constexpr inline std::string_view text() const
 	{
-		return { m_length >= kBufferSize ? m_data : m_local_data, m_length };
+		return { m_length >= kBufferSize or m_interned ? m_data : m_local_data, m_length };
+	}
+
+	/// \brief Return the id in the string_table for interned values or string_table::npos
+	uint32_t interned_id() const
+	{
+		return m_interned ? string_table::id(m_data) : string_table::npos;
 	}
 };
 
@@ -348,6 +506,10 @@ struct item_handle
 
 	std::string_view text() const;
 
+	/// \brief Return the id of the value in the string_table of its category
+	/// if the column is interned, or string_table::npos otherwise
+	uint32_t interned_id() const;
+
 	item_handle(uint16_t column, row_handle &row)
 		: m_column(column)
 		, m_row_handle(row)
@@ -364,6 +526,10 @@ struct item_handle
   private:
 	item_handle();
 
+	// Return the number parsed from the value when it was stored in the row
+	std::errc cached_number(double &value) const;
+	std::errc cached_number(float &value) const;
+
 	uint16_t m_column;
 	row_handle &m_row_handle;
 
@@ -377,24 +543,37 @@ struct item_handle::item_value_as<T, std::enable_if_t<std::is_arithmetic_v<T> an
 {
 	using value_type = std::remove_reference_t<std::remove_cv_t<T>>;
 
+	// floats and doubles use the number cached in the row
+	static constexpr bool kCached = std::is_same_v<value_type, float> or std::is_same_v<value_type, double>;
+
+	static std::errc parse(const item_handle &ref, value_type &v)
+	{
+		if constexpr (kCached)
+			return ref.cached_number(v);
+		else
+		{
+			auto txt = ref.text();
+			return selected_charconv<value_type>::from_chars(txt.data(), txt.data() + txt.size(), v).ec;
+		}
+	}
+
 	static value_type convert(const item_handle &ref)
 	{
 		value_type result = {};
 
 		if (not ref.empty())
 		{
-			auto txt = ref.text();
-
-			std::from_chars_result r = selected_charconv<value_type>::from_chars(txt.data(), txt.data() + txt.size(), result);
+			auto ec = parse(ref, result);
 
-			if (r.ec != std::errc())
+			if (ec != std::errc())
 			{
 				result = {};
 				if (cif::VERBOSE)
 				{
-					if (r.ec == std::errc::invalid_argument)
+					auto txt = ref.text();
+					if (ec == std::errc::invalid_argument)
 						std::cerr << "Attempt to convert " << std::quoted(txt) << " into a number" << std::endl;
-					else if (r.ec == std::errc::result_out_of_range)
+					else if (ec == std::errc::result_out_of_range)
 						std::cerr << "Conversion of " << std::quoted(txt) << " into a type that is too small" << std::endl;
 				}
 			}
@@ -415,15 +594,15 @@ struct item_handle::item_value_as<T, std::enable_if_t<std::is_arithmetic_v<T> an
 		{
 			value_type v = {};
 
-			std::from_chars_result r = selected_charconv<value_type>::from_chars(txt.data(), txt.data() + txt.size(), v);
+			auto ec = parse(ref, v);
 
-			if (r.ec != std::errc())
+			if (ec != std::errc())
 			{
 				if (cif::VERBOSE)
 				{
-					if (r.ec == std::errc::invalid_argument)
+					if (ec == std::errc::invalid_argument)
 						std::cerr << "Attempt to convert " << std::quoted(txt) << " into a number" << std::endl;
-					else if (r.ec == std::errc::result_out_of_range)
+					else if (ec == std::errc::result_out_of_range)
 						std::cerr << "Conversion of " << std::quoted(txt) << " into a type that is too small" << std::endl;
 				}
 				result = 1;
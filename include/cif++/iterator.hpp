@@ -29,6 +29,8 @@
 #include "cif++/row.hpp"
 
 #include <array>
+#include <limits>
+#include <optional>
 
 namespace cif
 {
@@ -469,6 +471,12 @@ class conditional_iterator_proxy
   public:
 	static constexpr const size_t N = sizeof...(Ts);
 
+	// value for the index of the candidates when these are not used
+	static constexpr const size_t kNoCandidates = std::numeric_limits<size_t>::max();
+
+	// value for the limit when all rows that match are returned
+	static constexpr const size_t kNoLimit = std::numeric_limits<size_t>::max();
+
 	using category_type = std::remove_cv_t<CategoryType>;
 
 	using base_iterator = iterator_impl<CategoryType, Ts...>;
@@ -485,7 +493,8 @@ class conditional_iterator_proxy
 		using pointer = value_type *;
 		using reference = value_type;
 
-		conditional_iterator_impl(CategoryType &cat, row_iterator pos, const condition &cond, const std::array<uint16_t, N> &cix);
+		conditional_iterator_impl(CategoryType &cat, row_iterator pos, const condition &cond, const std::array<uint16_t, N> &cix,
+			size_t candidate = kNoCandidates, size_t limit = kNoLimit);
 		conditional_iterator_impl(const conditional_iterator_impl &i) = default;
 		conditional_iterator_impl &operator=(const conditional_iterator_impl &i) = default;
 
@@ -503,13 +512,38 @@ class conditional_iterator_proxy
 
 		conditional_iterator_impl &operator++()
 		{
-			while (mBegin != mEnd)
+			// stop without looking for the next row once the limit is reached
+			if (m_remaining != kNoLimit and --m_remaining == 0)
+				mBegin = mEnd;
+			else if (m_candidate != kNoCandidates)
 			{
-				if (++mBegin == mEnd)
-					break;
+				// continue with the next row found in the index that matches
+				auto &candidates = *m_condition->candidates();
+
+				while (++m_candidate < candidates.size())
+				{
+					if (m_condition->candidate_matches({ *mCat, *candidates[m_candidate] }))
+						break;
+				}
 
-				if (m_condition->operator()(mBegin))
-					break;
+				mBegin = base_iterator(m_candidate < candidates.size() ? row_iterator(*mCat, candidates[m_candidate]) : mCat->end(), m_cix);
+			}
+			else if (m_condition->program() != nullptr)
+			{
+				// the compiled condition evaluates the next rows in batches
+				if (mBegin != mEnd)
+					mBegin = base_iterator(next_match(*mCat, ++mBegin, *m_condition), m_cix);
+			}
+			else
+			{
+				while (mBegin != mEnd)
+				{
+					if (++mBegin == mEnd)
+						break;
+
+					if (m_condition->operator()(mBegin))
+						break;
+				}
 			}
 
 			return *this;
@@ -532,9 +566,18 @@ class conditional_iterator_proxy
 		bool operator!=(const iterator_impl<IRowType, ITs...> &rhs) const { return mBegin != rhs; }
 
 	  private:
+		friend class conditional_iterator_proxy;
+
 		CategoryType *mCat;
 		base_iterator mBegin, mEnd;
 		const condition *m_condition;
+		std::array<uint16_t, N> m_cix;
+
+		// the index of mBegin in the candidates of m_condition, if these are used
+		size_t m_candidate;
+
+		// the number of rows left to return, including mBegin
+		size_t m_remaining;
 	};
 
 	using iterator = conditional_iterator_impl;
@@ -556,7 +599,34 @@ class conditional_iterator_proxy
 
 	explicit operator bool() const { return not empty(); }
 
-	size_t size() const { return std::distance(begin(), end()); }
+	/// \brief The number of rows returned, counted once and then cached
+	size_t size() const
+	{
+		if (not m_size.has_value())
+			m_size = std::distance(begin(), end());
+		return *m_size;
+	}
+
+	/// \brief Skip the first \a n rows that match
+	conditional_iterator_proxy &offset(size_t n) &;
+	conditional_iterator_proxy offset(size_t n) &&
+	{
+		return std::move(offset(n));
+	}
+
+	/// \brief Return at most \a n rows, no rows are tested after the last
+	/// one returned
+	conditional_iterator_proxy &limit(size_t n) &
+	{
+		m_limit = n;
+		m_size.reset();
+		return *this;
+	}
+
+	conditional_iterator_proxy limit(size_t n) &&
+	{
+		return std::move(limit(n));
+	}
 
 	row_handle front() { return *begin(); }
 	// row_handle back() { return *begin(); }
@@ -566,10 +636,28 @@ class conditional_iterator_proxy
 	void swap(conditional_iterator_proxy &rhs);
 
   private:
+	// Return the first row starting at \a pos that matches \a cond, using
+	// the program compiled for it
+	template <typename I>
+	static row_iterator next_match(CategoryType &cat, const I &pos, const condition &cond)
+	{
+		if (pos == cat.end())
+			return cat.end();
+
+		auto r = cond.program()->find_next(static_cast<const row_handle>(pos).get_row());
+		return r != nullptr ? row_iterator(cat, const_cast<row *>(r)) : cat.end();
+	}
+
 	CategoryType *m_cat;
 	condition m_condition;
 	row_iterator mCBegin, mCEnd;
 	std::array<uint16_t, N> mCix;
+
+	// the index of mCBegin in the candidates of m_condition, if these are used
+	size_t m_candidate = kNoCandidates;
+
+	size_t m_limit = kNoLimit;
+	mutable std::optional<size_t> m_size;
 };
 
 // --------------------------------------------------------------------
@@ -601,12 +689,17 @@ iterator_proxy<Category, Ts...>::iterator_proxy(Category &cat, row_iterator pos,
 
 template <typename Category, typename... Ts>
 conditional_iterator_proxy<Category, Ts...>::conditional_iterator_impl::conditional_iterator_impl(
-	Category &cat, row_iterator pos, const condition &cond, const std::array<uint16_t, N> &cix)
+	Category &cat, row_iterator pos, const condition &cond, const std::array<uint16_t, N> &cix, size_t candidate, size_t limit)
 	: mCat(&cat)
 	, mBegin(pos, cix)
 	, mEnd(cat.end(), cix)
 	, m_condition(&cond)
+	, m_cix(cix)
+	, m_candidate(candidate)
+	, m_remaining(limit)
 {
+	if (m_remaining == 0)
+		mBegin = mEnd;
 }
 
 template <typename Category, typename... Ts>
@@ -615,6 +708,9 @@ conditional_iterator_proxy<Category, Ts...>::conditional_iterator_proxy(conditio
 	, mCBegin(p.mCBegin)
 	, mCEnd(p.mCEnd)
 	, mCix(p.mCix)
+	, m_candidate(p.m_candidate)
+	, m_limit(p.m_limit)
+	, m_size(p.m_size)
 {
 	std::swap(m_cat, p.m_cat);
 	std::swap(mCix, p.mCix);
@@ -631,10 +727,26 @@ conditional_iterator_proxy<Category, Ts...>::conditional_iterator_proxy(Category
 {
 	static_assert(sizeof...(Ts) == sizeof...(Ns), "Number of column names should be equal to number of requested value types");
 
-	m_condition.prepare(cat);
+	// the condition may have been prepared already, see category::find
+	if (not m_condition.prepared())
+		m_condition.prepare(cat);
+
+	// Use the rows found in an index, unless starting halfway
+	if (auto cs = m_condition.candidates(); cs != nullptr and mCBegin == cat.begin())
+	{
+		m_candidate = 0;
+		while (m_candidate < cs->size() and not m_condition.candidate_matches({ cat, *(*cs)[m_candidate] }))
+			++m_candidate;
 
-	while (mCBegin != mCEnd and not m_condition(*mCBegin))
-		++mCBegin;
+		mCBegin = m_candidate < cs->size() ? row_iterator(cat, (*cs)[m_candidate]) : mCEnd;
+	}
+	else if (m_condition.program() != nullptr)
+		mCBegin = next_match(cat, mCBegin, m_condition);
+	else
+	{
+		while (mCBegin != mCEnd and not m_condition(*mCBegin))
+			++mCBegin;
+	}
 
 	uint16_t i = 0;
 	((mCix[i++] = m_cat->get_column_ix(names)), ...);
@@ -650,7 +762,7 @@ conditional_iterator_proxy<Category, Ts...> &conditional_iterator_proxy<Category
 template <typename Category, typename... Ts>
 typename conditional_iterator_proxy<Category, Ts...>::iterator conditional_iterator_proxy<Category, Ts...>::begin() const
 {
-	return iterator(*m_cat, mCBegin, m_condition, mCix);
+	return iterator(*m_cat, mCBegin, m_condition, mCix, m_candidate, m_limit);
 }
 
 template <typename Category, typename... Ts>
@@ -662,7 +774,28 @@ typename conditional_iterator_proxy<Category, Ts...>::iterator conditional_itera
 template <typename Category, typename... Ts>
 bool conditional_iterator_proxy<Category, Ts...>::empty() const
 {
-	return mCBegin == mCEnd;
+	return mCBegin == mCEnd or m_limit == 0;
+}
+
+template <typename Category, typename... Ts>
+conditional_iterator_proxy<Category, Ts...> &conditional_iterator_proxy<Category, Ts...>::offset(size_t n) &
+{
+	iterator i(*m_cat, mCBegin, m_condition, mCix, m_candidate);
+	for (; n > 0 and i.mBegin != i.mEnd; --n)
+		++i;
+
+	if (i.mBegin == i.mEnd)
+		mCBegin = mCEnd;
+	else
+	{
+		const row_handle rh = i.mBegin;
+		mCBegin = row_iterator(*m_cat, const_cast<row *>(rh.get_row()));
+	}
+
+	m_candidate = i.m_candidate;
+	m_size.reset();
+
+	return *this;
 }
 
 template <typename Category, typename... Ts>
@@ -673,6 +806,9 @@ void conditional_iterator_proxy<Category, Ts...>::swap(conditional_iterator_prox
 	std::swap(mCBegin, rhs.mCBegin);
 	std::swap(mCEnd, rhs.mCEnd);
 	std::swap(mCix, rhs.mCix);
+	std::swap(m_candidate, rhs.m_candidate);
+	std::swap(m_limit, rhs.m_limit);
+	std::swap(m_size, rhs.m_size);
 }
 
 } // namespace cif
\ No newline at end of file
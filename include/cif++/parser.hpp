@@ -29,6 +29,7 @@
 #include "cif++/row.hpp"
 
 #include <map>
+#include <memory>
 
 namespace cif
 {
@@ -96,6 +97,33 @@ class sac_parser
 
 	static bool is_unquoted_string(std::string_view text);
 
+	/// \brief The implementations available for scanning runs of characters
+	/// in the tokenizer. These are only used when parsing data in memory.
+	enum class scanner_kind
+	{
+		scalar,
+		sse2,
+		avx2
+	};
+
+	/// \brief Return the scanner currently in use, by default this is
+	/// the best one supported by the CPU
+	static scanner_kind get_scanner();
+
+	/// \brief Select the scanner to use, if \a kind is not supported by the
+	/// CPU the best supported alternative is selected instead. Returns the
+	/// scanner that was actually selected.
+	static scanner_kind set_scanner(scanner_kind kind);
+
+	/// \brief Return the maximum number of threads used to parse large
+	/// loop_ bodies, by default this is the number of hardware threads
+	static std::size_t get_thread_count();
+
+	/// \brief Set the maximum number of threads used to parse large loop_
+	/// bodies. A value of one turns off parallel parsing, zero selects the
+	/// default.
+	static void set_thread_count(std::size_t count);
+
   protected:
 	static constexpr uint8_t kCharTraitsTable[128] = {
 		//	0	1	2	3	4	5	6	7	8	9	a	b	c	d	e	f
@@ -148,6 +176,13 @@ class sac_parser
 	// Put the last read character back into the istream
 	void retract();
 
+	// Start collecting a new token at the current position
+	void start_token();
+
+	// Return the text of the current token, stripped from \a skip_front
+	// leading and \a skip_back trailing characters
+	std::string_view token_text(std::size_t skip_front = 0, std::size_t skip_back = 0);
+
 	CIFToken get_next_token();
 
 	void match(CIFToken token);
@@ -161,16 +196,46 @@ class sac_parser
 
 	void parse_file();
 
+	/// \brief Only produce the categories named in \a categories, the values
+	/// of all other categories are skipped. An empty set selects all categories.
+	void set_category_filter(const iset &categories)
+	{
+		m_category_filter = categories;
+	}
+
   protected:
 
 	sac_parser(std::istream &is, bool init = true);
 
+	/// \brief Constructor for a parser working directly on the \a length
+	/// bytes at \a data, e.g. a memory mapped file. Tokens are not copied but
+	/// refer to \a data, which should therefore outlive the parser.
+	sac_parser(const char *data, std::size_t length, bool init = true);
+
 	void parse_global();
 
 	void parse_datablock();
 
 	virtual void parse_save_frame();
 
+	bool is_selected(const std::string &category) const
+	{
+		return m_category_filter.empty() or m_category_filter.count(category) > 0;
+	}
+
+	// A range of complete rows in the body of a loop_, \a text is followed
+	// by white space or the end of the data. \a line_nr is the line number
+	// at the start of \a text.
+	struct loop_chunk
+	{
+		std::string_view text;
+		uint32_t line_nr;
+	};
+
+	// When parsing from memory, large loop_ bodies are split into chunks
+	// first. If there is more than one, these are passed to produce_rows.
+	void parse_loop_body_in_chunks(const std::string &category, const std::vector<std::string> &items);
+
 	void error(const std::string &msg)
 	{
 		if (cif::VERBOSE > 0)
@@ -192,6 +257,33 @@ class sac_parser
 	virtual void produce_row() = 0;
 	virtual void produce_item(std::string_view category, std::string_view item, std::string_view value) = 0;
 
+	// Called with the items of a loop_ before its values are produced. The
+	// values are then passed to produce_loop_item, with \a column being the
+	// index of \a item in \a items. By default this calls produce_item.
+	virtual void produce_loop_header(std::string_view category, const std::vector<std::string> &items)
+	{
+	}
+
+	virtual void produce_loop_item(std::size_t column, std::string_view category, std::string_view item, std::string_view value)
+	{
+		produce_item(category, item, value);
+	}
+
+	// Return whether the values of the loop_ with \a items, just passed to
+	// produce_loop_header, may be passed to produce_rows. Only then is the
+	// body of the loop_ split into chunks.
+	virtual bool wants_rows(std::string_view category, const std::vector<std::string> &items)
+	{
+		return false;
+	}
+
+	// Produce the rows in \a chunks, possibly in parallel. Return false to
+	// have the rows produced one by one with the methods above instead.
+	virtual bool produce_rows(std::string_view category, const std::vector<std::string> &items, const std::vector<loop_chunk> &chunks)
+	{
+		return false;
+	}
+
   protected:
 
 	enum class State
@@ -212,9 +304,33 @@ class sac_parser
 		Value
 	};
 
+	// streambuf for in-memory data, offering direct access to the read position
+	class memory_buffer : public std::streambuf
+	{
+	  public:
+		memory_buffer(const char *data, std::size_t length)
+		{
+			auto p = const_cast<char *>(data);
+			this->setg(p, p, p + length);
+		}
+
+		const char *begin() const { return this->eback(); }
+		const char *pos() const { return this->gptr(); }
+		const char *end() const { return this->egptr(); }
+
+		void unget(int n) { this->gbump(-n); }
+		void advance(const char *p) { this->setg(this->eback(), const_cast<char *>(p), this->egptr()); }
+
+	  protected:
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+	};
+
+	std::unique_ptr<memory_buffer> m_buffer;
 	std::streambuf &m_source;
 
 	// Parser state
+	iset m_category_filter;
 	uint32_t m_line_nr;
 	bool m_bol;
 	CIFToken m_lookahead;
@@ -222,6 +338,12 @@ class sac_parser
 	// token buffer
 	std::vector<char> m_token_buffer;
 	std::string_view m_token_value;
+
+	// token state when reading from m_buffer
+	const char *m_token_start = nullptr;
+	uint32_t m_token_line_nr = 0;
+	bool m_token_has_cr = false;
+	int m_last_char = 0, m_last_width = 0;
 };
 
 // --------------------------------------------------------------------
@@ -235,6 +357,12 @@ class parser : public sac_parser
 	{
 	}
 
+	parser(const char *data, std::size_t length, file &file)
+		: sac_parser(data, length)
+		, m_file(file)
+	{
+	}
+
 	void produce_datablock(std::string_view name) override;
 
 	void produce_category(std::string_view name) override;
@@ -243,11 +371,24 @@ class parser : public sac_parser
 
 	void produce_item(std::string_view category, std::string_view item, std::string_view value) override;
 
+	void produce_loop_header(std::string_view category, const std::vector<std::string> &items) override;
+
+	void produce_loop_item(std::size_t column, std::string_view category, std::string_view item, std::string_view value) override;
+
+	bool wants_rows(std::string_view category, const std::vector<std::string> &items) override;
+
+	bool produce_rows(std::string_view category, const std::vector<std::string> &items, const std::vector<loop_chunk> &chunks) override;
+
   protected:
+	class loop_chunk_parser;
+
 	file &m_file;
 	datablock *m_datablock = nullptr;
 	category *m_category = nullptr;
 	row_handle m_row;
+
+	// column indices for the items in the current loop_
+	std::vector<uint16_t> m_loop_columns;
 };
 
 } // namespace cif
@@ -0,0 +1,186 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cif++/category.hpp"
+
+#include <string>
+#include <vector>
+
+/// \file prepared_query.hpp
+/// This file contains the definition of prepared_query, a condition that
+/// is prepared once for a category and then run many times with different
+/// values for its parameters.
+
+namespace cif
+{
+
+// --------------------------------------------------------------------
+/// \brief A condition prepared for a single category, with parameters
+/// that are bound to values before running it.
+///
+/// Columns are looked up and the sub conditions are ordered once, binding
+/// new values only looks up the rows for these values in the indices.
+/// Parameters are created using cif::parameter. Values bound to them are
+/// compared as numbers if they are numbers and as text otherwise, an empty
+/// text compares like cif::null. E.g.:
+///
+/// @code {.cpp}
+/// cif::prepared_query q(db["atom_site"], "label_asym_id"_key == cif::parameter(0) and "label_seq_id"_key == cif::parameter(1));
+///
+/// for (int seq_id = 1; seq_id < 100; ++seq_id)
+/// {
+/// 	for (auto atom : q.find("A", seq_id))
+/// 		...
+/// }
+/// @endcode
+///
+/// The category should outlive the query. If the category is modified, the
+/// values are bound again before the next run.
+
+class prepared_query
+{
+  public:
+	prepared_query(category &cat, condition &&cond);
+
+	prepared_query(const prepared_query &) = delete;
+	prepared_query &operator=(const prepared_query &) = delete;
+
+	/// \brief Bind \a values to the parameters, parameter 0 to the first
+	template <typename... Ts>
+	prepared_query &bind(const Ts &...values)
+	{
+		m_values.resize(sizeof...(Ts));
+
+		size_t ix = 0;
+		(assign(m_values[ix++], values), ...);
+
+		bind();
+
+		return *this;
+	}
+
+	/// \brief Return the number of rows that match
+	size_t count();
+
+	/// \brief Return whether a row matches
+	bool exists();
+
+	/// \brief Return the rows that match, in the order of the category
+	std::vector<row_handle> find();
+
+	/// \brief Return the single row that matches, throws multiple_results_error
+	/// if there is not exactly one
+	row_handle find1();
+
+	/// \brief Return the first row that matches or an empty row_handle
+	row_handle find_first();
+
+	/// \brief Bind \a values and return the number of rows that match
+	template <typename... Ts>
+	size_t count(const Ts &...values)
+	{
+		return bind(values...).count();
+	}
+
+	/// \brief Bind \a values and return whether a row matches
+	template <typename... Ts>
+	bool exists(const Ts &...values)
+	{
+		return bind(values...).exists();
+	}
+
+	/// \brief Bind \a values and return the rows that match
+	template <typename... Ts>
+	std::vector<row_handle> find(const Ts &...values)
+	{
+		return bind(values...).find();
+	}
+
+	/// \brief Bind \a values and return the single row that matches
+	template <typename... Ts>
+	row_handle find1(const Ts &...values)
+	{
+		return bind(values...).find1();
+	}
+
+	/// \brief Bind \a values and return the first row that matches
+	template <typename... Ts>
+	row_handle find_first(const Ts &...values)
+	{
+		return bind(values...).find_first();
+	}
+
+	/// \brief The prepared condition, writing it shows the access path
+	/// chosen for the values bound last
+	const condition &get_condition() const
+	{
+		return m_condition;
+	}
+
+  private:
+	template <typename T>
+	static void assign(detail::bound_value &v, const T &value)
+	{
+		v.m_number.reset();
+		v.m_float = false;
+
+		if constexpr (std::is_convertible_v<const T &, std::string_view>)
+			v.m_text.assign(std::string_view(value));
+		else
+		{
+			v.m_text.assign(item("", value).value());
+
+			if constexpr (std::is_arithmetic_v<T> and not std::is_same_v<T, bool>)
+			{
+				v.m_number = static_cast<double>(value);
+				v.m_float = std::is_same_v<T, float>;
+			}
+		}
+	}
+
+	void prepare();
+	void bind();
+
+	// Call \a f for each row that matches, until it returns false
+	template <typename F>
+	void for_each(F &&f);
+
+	category &m_category;
+	condition m_condition;
+	std::vector<detail::bound_value> m_values;
+
+	// the generation of the category when the values were bound
+	bool m_bound = false;
+	uint32_t m_generation = 0;
+
+	// the columns of the category when the condition was prepared
+	size_t m_column_count = 0;
+	uint32_t m_column_layout = 0;
+};
+
+} // namespace cif
@@ -104,43 +104,142 @@ auto tie(Ts &...v)
 
 // --------------------------------------------------------------------
 /// \brief the row class, this one is not directly accessible from the outside
-
-class row : public std::vector<item_value>
+///
+/// Rows are allocated by their category from a pool, see row_pool. The
+/// items of a row are stored in an array allocated along with the row,
+/// large enough for the columns the category had at that time. Only when
+/// more items are needed, the items are moved to a separate allocation.
+/// The text of long values is stored in the string_arena of the category,
+/// values of interned columns point into its string_table.
+
+class row
 {
   public:
 	row() = default;
 
+	row(const row &) = delete;
+	row &operator=(const row &) = delete;
+
+	~row()
+	{
+		if (m_owns_items)
+			delete[] m_items;
+		delete[] m_numbers;
+	}
+
+	uint16_t size() const
+	{
+		return m_size;
+	}
+
+	item_value &operator[](uint16_t ix)
+	{
+		assert(ix < m_size);
+		return m_items[ix];
+	}
+
+	const item_value &operator[](uint16_t ix) const
+	{
+		assert(ix < m_size);
+		return m_items[ix];
+	}
+
 	item_value* get(uint16_t ix)
 	{
-		return ix < size() ? &data()[ix] : nullptr;
+		return ix < m_size ? m_items + ix : nullptr;
 	}
 
 	const item_value* get(uint16_t ix) const
 	{
-		return ix < size() ? &data()[ix] : nullptr;
+		return ix < m_size ? m_items + ix : nullptr;
 	}
 
   private:
 	friend class category;
 	friend class category_index;
+	friend class parser;
+	friend class row_pool;
+	friend class column_store;
+	friend struct item_handle;
+	friend class detail::condition_program;
+	friend class prepared_query;
 
 	template <typename, typename...>
 	friend class iterator_impl;
 
-	void append(uint16_t ix, item_value &&iv)
+	void append(uint16_t ix, std::string_view value, string_arena &arena)
 	{
-		if (ix >= size())
-			resize(ix + 1);
+		if (ix >= m_size)
+			resize(ix + 1, arena);
+		else
+			m_items[ix].release(arena);
 		
-		at(ix) = std::move(iv);
+		m_items[ix] = item_value(value, arena);
+		forget_number(ix);
 	}
 
-	void remove(uint16_t ix)
+	void intern(uint16_t ix, std::string_view value, string_table &table, string_arena &arena)
 	{
-		if (ix < size())
-			at(ix) = item_value{};
+		if (ix >= m_size)
+			resize(ix + 1, arena);
+		else
+			m_items[ix].release(arena);
+		
+		m_items[ix] = item_value(value, table);
+		forget_number(ix);
 	}
 
+	void remove(uint16_t ix, string_arena &arena)
+	{
+		if (ix < m_size)
+		{
+			m_items[ix].release(arena);
+			forget_number(ix);
+		}
+	}
+
+	void resize(uint16_t size, string_arena &arena);
+
+	// The numbers parsed from the items are cached in m_numbers, which is
+	// allocated on the first numeric read of the row. Rows that are not
+	// read as numbers cost nothing extra, others 8 bytes per item. Const
+	// readers fill the cache using atomic stores, parsing the same text
+	// results in the same value in each thread. The value kNotParsed marks
+	// an empty slot, kInvalid and kOutOfRange are used for values that are
+	// not numbers. These are NaNs that from_chars does not produce.
+	static constexpr uint64_t kNotParsed = ~uint64_t(0);
+	static constexpr uint64_t kInvalid = ~uint64_t(1);
+	static constexpr uint64_t kOutOfRange = ~uint64_t(2);
+
+	static uint64_t parse_number(std::string_view text);
+
+	std::errc number(uint16_t ix, double &value) const;
+
+	// The result is the same as parsing the text as a float, values outside
+	// the range of a float result in result_out_of_range
+	std::errc number(uint16_t ix, float &value) const;
+
+	void forget_number(uint16_t ix)
+	{
+		if (m_numbers != nullptr)
+			m_numbers[ix] = kNotParsed;
+	}
+
+	void swap_item(uint16_t ix, row &b)
+	{
+		std::swap(m_items[ix], b.m_items[ix]);
+		forget_number(ix);
+		b.forget_number(ix);
+	}
+
+	// items beyond m_size are always empty
+	item_value *m_items = nullptr;
+	mutable uint64_t *m_numbers = nullptr;
+	uint16_t m_size = 0;
+	uint16_t m_capacity = 0;
+	// position in the category, see category::update_ordinals
+	uint32_t m_ordinal = 0;
+	bool m_owns_items = false;
 	row *m_next = nullptr;
 };
 
@@ -153,7 +252,12 @@ class row_handle
 	friend struct item_handle;
 	friend class category;
 	friend class category_index;
+	friend class secondary_index;
 	friend class row_initializer;
+	friend class parser;
+
+	template <typename, typename...>
+	friend class conditional_iterator_proxy;
 
 	row_handle() = default;
 
@@ -194,6 +298,10 @@ class row_handle
 		return empty() ? item_handle::s_null_item : item_handle(column_ix, const_cast<row_handle &>(*this));
 	}
 
+	/// \brief Access the column referred to by \a column, see column_ref
+	item_handle operator[](const column_ref &column);
+	const item_handle operator[](const column_ref &column) const;
+
 	item_handle operator[](std::string_view column_name)
 	{
 		return empty() ? item_handle::s_null_item : item_handle(add_column(column_name), *this);
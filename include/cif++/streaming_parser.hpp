@@ -0,0 +1,237 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2023 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "cif++/parser.hpp"
+
+#include <array>
+#include <functional>
+#include <iomanip>
+#include <optional>
+#include <utility>
+
+/// \file streaming_parser.hpp
+/// This file contains the definition of streaming_parser, a parser that
+/// passes the rows of selected categories to callbacks without storing
+/// anything. This allows scanning large collections of files in constant
+/// memory.
+
+namespace cif
+{
+
+// --------------------------------------------------------------------
+
+namespace detail
+{
+	template <typename T, typename = void>
+	struct streamed_value_as;
+
+	template <>
+	struct streamed_value_as<std::string_view>
+	{
+		static std::string_view convert(std::string_view v)
+		{
+			return v;
+		}
+	};
+
+	template <>
+	struct streamed_value_as<std::string>
+	{
+		static std::string convert(std::string_view v)
+		{
+			return { v.data(), v.length() };
+		}
+	};
+
+	template <typename T>
+	struct streamed_value_as<T, std::enable_if_t<std::is_arithmetic_v<T> and not std::is_same_v<T, bool>>>
+	{
+		static T convert(std::string_view v)
+		{
+			T result = {};
+
+			if (not v.empty() and v != "." and v != "?")
+			{
+				auto r = selected_charconv<T>::from_chars(v.data(), v.data() + v.length(), result);
+
+				if (r.ec != std::errc())
+				{
+					result = {};
+					if (cif::VERBOSE)
+						std::cerr << "Attempt to convert " << std::quoted(v) << " into a number" << std::endl;
+				}
+			}
+
+			return result;
+		}
+	};
+
+	template <typename T>
+	struct streamed_value_as<std::optional<T>>
+	{
+		static std::optional<T> convert(std::string_view v)
+		{
+			std::optional<T> result;
+			if (not v.empty() and v != "." and v != "?")
+				result = streamed_value_as<T>::convert(v);
+			return result;
+		}
+	};
+} // namespace detail
+
+// --------------------------------------------------------------------
+/// \brief A parser that does not build a cif::file but passes the rows
+/// of the categories subscribed to to callbacks.
+///
+/// Values are passed as std::string_view, these are only valid during
+/// the callback. When parsing from memory they point into the data
+/// parsed, otherwise into a buffer that is reused for each row. Items
+/// that are missing in a row and the value '?' are passed as empty
+/// strings, the value '.' is passed as is. Categories that are not
+/// subscribed to are skipped.
+///
+/// \code
+/// cif::streaming_parser p(is);
+/// p.subscribe<std::string, float>("atom_site", { "type_symbol", "B_iso_or_equiv" },
+///     [&](std::string type, float b) { ... });
+/// p.parse_file();
+/// \endcode
+
+class streaming_parser : public sac_parser
+{
+  public:
+	using row_callback = std::function<void(const std::vector<std::string_view> &)>;
+	using datablock_callback = std::function<void(std::string_view)>;
+
+	streaming_parser(std::istream &is)
+		: sac_parser(is)
+	{
+	}
+
+	/// \brief Parse the \a length bytes at \a data, which should outlive the parser
+	streaming_parser(const char *data, std::size_t length)
+		: sac_parser(data, length)
+	{
+	}
+
+	/// \brief Call \a callback for each row in \a category with the values
+	/// of \a items, in the same order.
+	void subscribe(std::string_view category, std::vector<std::string> items, row_callback &&callback);
+
+	/// \brief Call \a callback for each row in \a category with the values
+	/// of \a items converted to Ts. Empty values, '.' and '?' result in a
+	/// default constructed value or an empty std::optional.
+	template <typename... Ts, typename F>
+	void subscribe(std::string_view category, const std::array<std::string_view, sizeof...(Ts)> &items, F &&callback)
+	{
+		static_assert(sizeof...(Ts) > 0, "Specify the types of the values");
+
+		subscribe(category, std::vector<std::string>(items.begin(), items.end()),
+			[cb = std::forward<F>(callback)](const std::vector<std::string_view> &values) mutable
+			{ invoke<Ts...>(cb, values, std::index_sequence_for<Ts...>{}); });
+	}
+
+	/// \brief Call \a callback for each datablock with its name
+	void on_datablock(datablock_callback &&callback)
+	{
+		m_datablock_callback = std::move(callback);
+	}
+
+	/// \brief Parse the whole file
+	void parse_file()
+	{
+		sac_parser::parse_file();
+		flush();
+	}
+
+	/// \brief Parse only the datablock named \a datablock
+	bool parse_single_datablock(const std::string &datablock)
+	{
+		bool result = sac_parser::parse_single_datablock(datablock);
+		flush();
+		return result;
+	}
+
+	bool parse_single_datablock(const std::string &datablock, const datablock_index &index)
+	{
+		bool result = sac_parser::parse_single_datablock(datablock, index);
+		flush();
+		return result;
+	}
+
+  protected:
+	void produce_datablock(std::string_view name) override;
+	void produce_category(std::string_view name) override;
+	void produce_row() override;
+	void produce_item(std::string_view category, std::string_view item, std::string_view value) override;
+	void produce_loop_header(std::string_view category, const std::vector<std::string> &items) override;
+	void produce_loop_item(std::size_t column, std::string_view category, std::string_view item, std::string_view value) override;
+
+  private:
+	template <typename... Ts, typename F, std::size_t... Is>
+	static void invoke(F &f, const std::vector<std::string_view> &values, std::index_sequence<Is...>)
+	{
+		f(detail::streamed_value_as<Ts>::convert(values[Is])...);
+	}
+
+	// A value of the current row. Values in the data being parsed are
+	// referred to directly, with m_data pointing to them. Other values
+	// are copied into m_row_buffer and m_data is null, these are
+	// located by offset since m_row_buffer may grow.
+	struct value_ref
+	{
+		const char *m_data = nullptr;
+		std::size_t m_offset = 0;
+		std::size_t m_length = 0;
+	};
+
+	struct subscription
+	{
+		std::string m_category;
+		std::vector<std::string> m_items;
+		row_callback m_callback;
+
+		// values of the current row and the index in m_items for
+		// each of the items in the current loop_, if any
+		std::vector<value_ref> m_values;
+		std::vector<std::size_t> m_loop_map;
+	};
+
+	value_ref store(std::string_view value);
+
+	void flush();
+
+	std::vector<subscription> m_subscriptions;
+	std::vector<subscription *> m_active;
+	bool m_in_row = false;
+	datablock_callback m_datablock_callback;
+	std::vector<std::string_view> m_row_values;
+	std::vector<char> m_row_buffer;
+};
+
+} // namespace cif
@@ -200,6 +200,36 @@ inline char tolower(int ch)
 	return static_cast<char>(kCharToLowerMap[static_cast<uint8_t>(ch)]);
 }
 
+// --------------------------------------------------------------------
+// Case insensitive hash and equality, for unordered containers
+
+struct ihash
+{
+	using is_transparent = void;
+
+	std::size_t operator()(std::string_view s) const
+	{
+		// FNV-1a on the lower case characters
+		std::size_t result = 14695981039346656037ULL;
+		for (char ch : s)
+		{
+			result ^= kCharToLowerMap[static_cast<uint8_t>(ch)];
+			result *= 1099511628211ULL;
+		}
+		return result;
+	}
+};
+
+struct iequal_to
+{
+	using is_transparent = void;
+
+	bool operator()(std::string_view a, std::string_view b) const
+	{
+		return iequals(a, b);
+	}
+};
+
 // --------------------------------------------------------------------
 
 std::tuple<std::string, std::string> split_tag_name(std::string_view tag);
@@ -29,6 +29,7 @@
 #include "cif++/exports.hpp"
 
 #include <filesystem>
+#include <functional>
 
 #ifndef STDOUT_FILENO
 #define STDOUT_FILENO 1
@@ -175,10 +176,79 @@ class progress_bar
 	struct progress_bar_impl *m_impl;
 };
 
+// --------------------------------------------------------------------
+//	A read-only memory mapped file. If mapping fails, e.g. because the
+//	file is empty or not a regular file, is_open() returns false.
+
+class mapped_file
+{
+  public:
+	mapped_file(const std::filesystem::path &p);
+	~mapped_file();
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	const char *data() const { return m_data; }
+	std::size_t size() const { return m_size; }
+
+	bool is_open() const { return m_data != nullptr; }
+	explicit operator bool() const { return is_open(); }
+
+  private:
+	const char *m_data = nullptr;
+	std::size_t m_size = 0;
+#if _MSC_VER
+	void *m_mapping = nullptr;
+#endif
+};
+
+// --------------------------------------------------------------------
+//	Call \a f for each index in [0, n) using at most \a thread_count threads,
+//	zero meaning the number of hardware threads. The calling thread takes
+//	part as well. The first exception thrown by \a f is rethrown after all
+//	threads have finished, indices not yet started at that time are skipped.
+
+void parallel_for(std::size_t n, const std::function<void(std::size_t)> &f, std::size_t thread_count = 0);
+
+namespace execution
+{
+	/// \brief Execution policies for category::find, count, exists and
+	/// erase, modelled after those in std::execution. E.g.:
+	///
+	/// @code {.cpp}
+	/// auto n = atom_site.count(cif::execution::par, "type_symbol"_key == "C");
+	/// @endcode
+
+	struct sequenced_policy
+	{
+	};
+
+	struct parallel_policy
+	{
+		/// \brief Return a policy using at most \a thread_count threads
+		constexpr parallel_policy operator()(std::size_t thread_count) const
+		{
+			return { thread_count };
+		}
+
+		/// \brief The maximum number of threads, zero meaning the number of
+		/// hardware threads
+		std::size_t m_thread_count = 0;
+	};
+
+	inline constexpr sequenced_policy seq{};
+	inline constexpr parallel_policy par{};
+} // namespace execution
+
 // --------------------------------------------------------------------
 // Resources
 
 std::unique_ptr<std::istream> load_resource(std::filesystem::path name);
+
+// Return the path of the file load_resource would use for \a name, or an
+// empty path if the resource is not found or is not a file on disk.
+std::filesystem::path locate_resource(std::filesystem::path name);
 void add_file_resource(const std::string &name, std::filesystem::path dataFile);
 void add_data_directory(std::filesystem::path dataDir);
 
@@ -50,6 +50,22 @@ class validation_error : public std::exception
 	std::string m_msg;
 };
 
+// --------------------------------------------------------------------
+/// \brief A single problem found by a batch validation, see file::validate
+
+struct validation_message
+{
+	std::string m_datablock;
+	std::string m_category;
+	std::string m_item;		///< empty if the problem is not specific for an item
+	std::size_t m_row;		///< index of the row in its category, or npos
+	std::string m_message;
+
+	bool operator==(const validation_message &rhs) const = default;
+};
+
+using validation_report = std::vector<validation_message>;
+
 // --------------------------------------------------------------------
 
 enum class DDL_PrimitiveType
@@ -131,6 +147,10 @@ struct item_validator
 	}
 
 	void operator()(std::string_view value) const;
+
+	/// \brief Validate \a value without throwing, returns false and
+	/// sets \a message if the value is not valid
+	bool validate_value(std::string_view value, std::string &message) const;
 };
 
 struct category_validator
@@ -25,12 +25,16 @@
  */
 
 #include "cif++/category.hpp"
+#include "cif++/column_store.hpp"
 #include "cif++/datablock.hpp"
 #include "cif++/parser.hpp"
 #include "cif++/utilities.hpp"
 
+#include <atomic>
+#include <bit>
+#include <mutex>
 #include <numeric>
-#include <stack>
+#include <unordered_set>
 
 // TODO: Find out what the rules are exactly for linked items, the current implementation
 // is inconsistent. It all depends whether a link is satified if a field taking part in the
@@ -42,11 +46,34 @@ namespace cif
 const uint32_t kMaxLineLength = 132;
 
 // --------------------------------------------------------------------
+//	The key of a row is stored in the index as a normalized byte string.
+//	Comparing two of these with memcmp gives the same order as comparing
+//	the key values with type_validator::compare. Each value is stored
+//	as a tag byte followed by its encoding:
+//
+//	  empty value             kEmpty
+//	  text                    kText, the characters, a terminating zero
+//	  number                  kNumber, 8 bytes, see below
+//
+//	For UChar values the characters are stored in lower case and for
+//	text values runs of spaces are stored as a single space. Values of
+//	type Numb that are not a number are stored as text.
+//
+//	The same encoding is used for the keys of secondary indices, these
+//	are made up of arbitrary columns. Columns without a type validator
+//	are treated as Char.
 
-class row_comparator
+class key_normalizer
 {
   public:
-	row_comparator(category &cat)
+	enum : char
+	{
+		kEmpty = 1,
+		kText = 2,
+		kNumber = 3
+	};
+
+	key_normalizer(category &cat)
 		: m_category(cat)
 	{
 		auto cv = cat.get_cat_validator();
@@ -63,492 +90,936 @@ class row_comparator
 			if (tv == nullptr)
 				throw std::runtime_error("Incomplete dictionary, no type Validator for Item " + k);
 
-			using namespace std::placeholders;
-
-			m_comparator.emplace_back(ix, std::bind(&type_validator::compare, tv, _1, _2));
+			m_keys.emplace_back(ix, tv->m_primitive_type);
 		}
 	}
 
-	int operator()(const row *a, const row *b) const
+	key_normalizer(category &cat, const std::vector<uint16_t> &columns)
+		: m_category(cat)
 	{
-		assert(a);
-		assert(b);
-
-		row_handle rha(m_category, *a);
-		row_handle rhb(m_category, *b);
+		auto cv = cat.get_cat_validator();
 
-		int d = 0;
-		for (const auto &[k, f] : m_comparator)
+		for (auto ix : columns)
 		{
-			std::string_view ka = rha[k].text();
-			std::string_view kb = rhb[k].text();
+			auto type = DDL_PrimitiveType::Char;
 
-			d = f(ka, kb);
+			auto iv = cv != nullptr ? cv->get_validator_for_item(cat.get_column_name(ix)) : nullptr;
+			if (iv != nullptr and iv->m_type != nullptr)
+				type = iv->m_type->m_primitive_type;
 
-			if (d != 0)
-				break;
+			m_keys.emplace_back(ix, type);
 		}
+	}
+
+	DDL_PrimitiveType get_type(size_t nr) const
+	{
+		return std::get<1>(m_keys[nr]);
+	}
 
-		return d;
+	// Append the encoding of \a v as value for the key column \a nr to \a key
+	void append(std::string &key, size_t nr, std::string_view v) const
+	{
+		append(key, get_type(nr), v);
 	}
 
-	int operator()(const row_initializer &a, const row *b) const
+	// Append the encoding of number \a d to \a key
+	static void append_number(std::string &key, double d)
 	{
-		assert(b);
+		// Flip the sign bit of positive numbers and all bits of negative
+		// numbers, the big endian bytes of the result sort like the numbers
+		auto bits = std::bit_cast<uint64_t>(d == 0 ? 0 : d);
+		bits = (bits & (uint64_t{ 1 } << 63)) ? ~bits : bits | (uint64_t{ 1 } << 63);
 
-		row_handle rhb(m_category, *b);
+		key += kNumber;
+		for (int shift = 56; shift >= 0; shift -= 8)
+			key += static_cast<char>(bits >> shift);
+	}
 
-		int d = 0;
-		auto ai = a.begin();
+	std::string operator()(const row *r) const
+	{
+		std::string result;
 
-		for (const auto &[k, f] : m_comparator)
+		for (const auto &[ix, type] : m_keys)
 		{
-			assert(ai != a.end());
+			auto iv = r->get(ix);
+			append(result, type, iv != nullptr ? iv->text() : std::string_view{});
+		}
+
+		return result;
+	}
 
-			std::string_view ka = ai->value();
-			std::string_view kb = rhb[k].text();
+	std::string operator()(const row_initializer &k) const
+	{
+		std::string result;
 
-			d = f(ka, kb);
+		for (const auto &[ix, type] : m_keys)
+		{
+			auto name = m_category.get_column_name(ix);
 
-			if (d != 0)
-				break;
-			
-			++ai;
+			auto ki = std::find_if(k.begin(), k.end(), [name](const item &i)
+				{ return iequals(i.name(), name); });
+
+			append(result, type, ki != k.end() ? ki->value() : std::string_view{});
 		}
 
-		return d;
+		return result;
 	}
 
   private:
-	using compareFunc = std::function<int(std::string_view, std::string_view)>;
-	using key_comparator = std::tuple<uint16_t, compareFunc>;
+	static void append(std::string &key, DDL_PrimitiveType type, std::string_view v)
+	{
+		if (v.empty())
+		{
+			key += kEmpty;
+			return;
+		}
+
+		if (type == DDL_PrimitiveType::Numb)
+		{
+			double d;
+			auto r = selected_charconv<double>::from_chars(v.data(), v.data() + v.length(), d);
+
+			if (r.ec == std::errc())
+			{
+				append_number(key, d);
+				return;
+			}
+		}
+
+		key += kText;
+
+		char last = 0;
+		for (char ch : v)
+		{
+			if (ch == ' ' and last == ' ')
+				continue;
+			last = ch;
+
+			key += type == DDL_PrimitiveType::UChar ? tolower(ch) : ch;
+		}
+
+		key += '\0';
+	}
 
-	std::vector<key_comparator> m_comparator;
+	std::vector<std::tuple<uint16_t, DDL_PrimitiveType>> m_keys;
 	category &m_category;
 };
 
 // --------------------------------------------------------------------
-//
-//	class to keep an index on the keys of a category. This is a red/black
-//	tree implementation.
 
-class category_index
+namespace
 {
-  public:
-	category_index(category *cat);
 
-	~category_index()
+std::string duplicate_key_message(const category &cat, row *r)
+{
+	row_handle rh(cat, *r);
+
+	std::ostringstream os;
+	for (auto col : cat.key_fields())
 	{
-		delete m_root;
+		if (rh[col])
+			os << col << ": " << std::quoted(rh[col].text()) << "; ";
 	}
 
-	row *find(row *k) const;
-	row *find_by_value(row_initializer k) const;
+	return "Duplicate Key violation, cat: " + cat.name() + " values: " + os.str();
+}
 
-	void insert(row *r);
-	void erase(row *r);
+} // namespace
 
-	// reorder the row's and returns new head and tail
-	std::tuple<row *, row *> reorder()
+// --------------------------------------------------------------------
+//
+//	Rows are allocated in slabs, as are their items. The items for a row
+//	are allocated at the same time as the row, so rows created one after
+//	the other have their items next to each other in memory. Rows that are
+//	deleted are kept in a free list, together with their items.
+
+class row_pool
+{
+  public:
+	row_pool() = default;
+	row_pool(const row_pool &) = delete;
+	row_pool &operator=(const row_pool &) = delete;
+
+	row *allocate(uint16_t item_count)
 	{
-		std::tuple<row *, row *> result = std::make_tuple(nullptr, nullptr);
+		std::unique_lock lock(m_mutex);
+
+		row *result = m_free;
 
-		if (m_root != nullptr)
+		if (result != nullptr)
 		{
-			entry *head = find_min(m_root);
-			entry *tail = reorder(m_root);
+			m_free = result->m_next;
+			result->m_next = nullptr;
+		}
+		else
+		{
+			if (m_rows_used == kRowsPerSlab)
+			{
+				m_row_slabs.emplace_back(new row[kRowsPerSlab]);
+				m_rows_used = 0;
+			}
+
+			result = &m_row_slabs.back()[m_rows_used++];
 
-			tail->m_row->m_next = nullptr;
+			if (item_count > 0)
+			{
+				if (m_items_used + item_count > m_item_slab_size)
+				{
+					m_item_slab_size = std::max<size_t>(kItemsPerSlab, item_count);
+					m_item_slabs.emplace_back(new item_value[m_item_slab_size]);
+					m_items_used = 0;
+				}
 
-			result = std::make_tuple(head->m_row, tail->m_row);
+				result->m_items = &m_item_slabs.back()[m_items_used];
+				result->m_capacity = item_count;
+				m_items_used += item_count;
+			}
 		}
 
 		return result;
 	}
 
-	size_t size() const;
-	//	bool isValid() const;
-
-  private:
-	struct entry
+	void deallocate(row *r)
 	{
-		entry(row *r)
-			: m_row(r)
-			, m_left(nullptr)
-			, m_right(nullptr)
-			, m_red(true)
-		{
-		}
-
-		~entry()
-		{
-			delete m_left;
-			delete m_right;
-		}
-
-		row *m_row;
-		entry *m_left;
-		entry *m_right;
-		bool m_red;
-	};
+		r->resize(0, m_arena);
 
-	entry *insert(entry *h, row *v);
-	entry *erase(entry *h, row *k);
+		std::unique_lock lock(m_mutex);
 
-	//	void validate(entry* h, bool isParentRed, uint32_t blackDepth, uint32_t& minBlack, uint32_t& maxBlack) const;
+		r->m_next = m_free;
+		m_free = r;
+	}
 
-	entry *rotateLeft(entry *h)
+	string_arena &get_arena()
 	{
-		entry *x = h->m_right;
-		h->m_right = x->m_left;
-		x->m_left = h;
-		x->m_red = h->m_red;
-		h->m_red = true;
-		return x;
+		return m_arena;
 	}
 
-	entry *rotateRight(entry *h)
+	string_table &get_string_table()
 	{
-		entry *x = h->m_left;
-		h->m_left = x->m_right;
-		x->m_right = h;
-		x->m_red = h->m_red;
-		h->m_red = true;
-		return x;
+		return m_strings;
 	}
 
-	void flipColour(entry *h)
+	// Move the rows, items and long values of \a rhs into this pool. The
+	// rows of \a rhs may not have interned values.
+	void merge(row_pool &&rhs)
 	{
-		h->m_red = not h->m_red;
+		std::unique_lock lock(m_mutex);
 
-		if (h->m_left != nullptr)
-			h->m_left->m_red = not h->m_left->m_red;
-
-		if (h->m_right != nullptr)
-			h->m_right->m_red = not h->m_right->m_red;
-	}
+		assert(rhs.m_strings.size() == 0);
 
-	constexpr bool is_red(entry *h) const
-	{
-		return h != nullptr and h->m_red;
-	}
+		// keep the current slabs of this pool last, to continue allocating from
+		if (m_row_slabs.empty())
+			m_rows_used = rhs.m_rows_used;
+		m_row_slabs.insert(m_row_slabs.end() - (m_row_slabs.empty() ? 0 : 1),
+			std::make_move_iterator(rhs.m_row_slabs.begin()), std::make_move_iterator(rhs.m_row_slabs.end()));
+		rhs.m_row_slabs.clear();
+		rhs.m_rows_used = kRowsPerSlab;
 
-	entry *move_red_left(entry *h)
-	{
-		flipColour(h);
+		if (m_item_slabs.empty())
+		{
+			m_items_used = rhs.m_items_used;
+			m_item_slab_size = rhs.m_item_slab_size;
+		}
+		m_item_slabs.insert(m_item_slabs.end() - (m_item_slabs.empty() ? 0 : 1),
+			std::make_move_iterator(rhs.m_item_slabs.begin()), std::make_move_iterator(rhs.m_item_slabs.end()));
+		rhs.m_item_slabs.clear();
+		rhs.m_items_used = rhs.m_item_slab_size = 0;
 
-		if (h->m_right != nullptr and is_red(h->m_right->m_left))
+		while (rhs.m_free != nullptr)
 		{
-			h->m_right = rotateRight(h->m_right);
-			h = rotateLeft(h);
-			flipColour(h);
+			auto r = rhs.m_free;
+			rhs.m_free = r->m_next;
+			r->m_next = m_free;
+			m_free = r;
 		}
 
-		return h;
+		m_arena.merge(std::move(rhs.m_arena));
 	}
 
-	entry *move_red_right(entry *h)
-	{
-		flipColour(h);
+  private:
+	static constexpr size_t kRowsPerSlab = 256;
+	static constexpr size_t kItemsPerSlab = 4096;
 
-		if (h->m_left != nullptr and is_red(h->m_left->m_left))
-		{
-			h = rotateRight(h);
-			flipColour(h);
-		}
+	std::mutex m_mutex;
 
-		return h;
-	}
+	std::vector<std::unique_ptr<row[]>> m_row_slabs;
+	size_t m_rows_used = kRowsPerSlab;
 
-	entry *fix_up(entry *h)
-	{
-		if (is_red(h->m_right))
-			h = rotateLeft(h);
+	std::vector<std::unique_ptr<item_value[]>> m_item_slabs;
+	size_t m_items_used = 0, m_item_slab_size = 0;
 
-		if (is_red(h->m_left) and is_red(h->m_left->m_left))
-			h = rotateRight(h);
+	row *m_free = nullptr;
 
-		if (is_red(h->m_left) and is_red(h->m_right))
-			flipColour(h);
+	string_arena m_arena;
+	string_table m_strings;
+};
 
-		return h;
-	}
+// --------------------------------------------------------------------
+//
+//	class to keep an index on the keys of a category. The normalized keys
+//	of the rows are stored in a vector of entries. The entries are found
+//	using a hash table with open addressing and linear probing, for the
+//	lookup of single rows.
+//
+//	The order of the keys is kept in m_order, a sorted array of entry
+//	numbers followed by the entries added out of order. These are sorted
+//	and merged only when the order is needed, in reorder. Erased entries
+//	are marked as such and removed once they outnumber the others.
 
-	entry *find_min(entry *h)
-	{
-		while (h->m_left != nullptr)
-			h = h->m_left;
+class category_index
+{
+  public:
+	category_index(category *cat);
+	category_index(category *cat, std::vector<row *> &duplicates);
+
+	row *find(row *k) const;
+	row *find_by_value(row_initializer k) const;
+
+	void insert(row *r);
+	void erase(row *r);
+
+	// insert \a r unless the index contains a row with the same key,
+	// returns whether \a r was inserted
+	bool try_insert(row *r);
 
-		return h;
+	// reorder the row's and returns new head and tail
+	std::tuple<row *, row *> reorder();
+
+	size_t size() const
+	{
+		return m_entries.size() - m_erased;
 	}
 
-	entry *erase_min(entry *h)
+  private:
+	static constexpr uint32_t kEmptySlot = std::numeric_limits<uint32_t>::max();
+
+	struct entry
 	{
-		if (h->m_left == nullptr)
-		{
-			delete h;
-			h = nullptr;
-		}
-		else
-		{
-			if (not is_red(h->m_left) and not is_red(h->m_left->m_left))
-				h = move_red_left(h);
+		row *m_row;
+		size_t m_hash;
+		std::string m_key;
+	};
 
-			h->m_left = erase_min(h->m_left);
+	void reserve(size_t n);
 
-			h = fix_up(h);
-		}
+	// Sort the entries added out of order and merge them with the others
+	void sort_order();
 
-		return h;
-	}
+	// Remove the erased entries
+	void compact();
 
-	// Fix m_next fields for rows in order of this index
-	entry *reorder(entry *e)
+	size_t mask() const
 	{
-		auto result = e;
+		return m_slots.size() - 1;
+	}
 
-		if (e->m_left != nullptr)
-		{
-			auto l = reorder(e->m_left);
-			l->m_row->m_next = e->m_row;
-		}
+	size_t hash(std::string_view key) const
+	{
+		return std::hash<std::string_view>{}(key);
+	}
 
-		if (e->m_right != nullptr)
+	// Return the slot containing the entry for \a key, or the empty
+	// slot where it should be stored
+	size_t find_slot(std::string_view key, size_t h) const
+	{
+		size_t i = h & mask();
+		while (m_slots[i] != kEmptySlot)
 		{
-			auto mr = find_min(e->m_right);
-			e->m_row->m_next = mr->m_row;
-
-			result = reorder(e->m_right);
+			auto &e = m_entries[m_slots[i]];
+			if (e.m_hash == h and e.m_key == key)
+				break;
+			i = (i + 1) & mask();
 		}
+		return i;
+	}
 
-		return result;
+	// Return the slot referring to entry \a ix
+	size_t find_entry_slot(uint32_t ix) const
+	{
+		size_t i = m_entries[ix].m_hash & mask();
+		while (m_slots[i] != ix)
+			i = (i + 1) & mask();
+		return i;
 	}
 
 	category &m_category;
-	row_comparator m_row_comparator;
-	entry *m_root;
+	key_normalizer m_key_normalizer;
+
+	// erased entries have no row
+	std::vector<entry> m_entries;
+	size_t m_erased = 0;
+
+	std::vector<uint32_t> m_slots;
+
+	// the entries ordered by key, up to m_sorted
+	std::vector<uint32_t> m_order;
+	size_t m_sorted = 0;
 };
 
 category_index::category_index(category *cat)
 	: m_category(*cat)
-	, m_row_comparator(m_category)
-	, m_root(nullptr)
+	, m_key_normalizer(m_category)
 {
+	reserve(m_category.size());
+
 	for (auto r : m_category)
-		insert(r.get_row());
+	{
+		if (not try_insert(r.get_row()))
+			throw duplicate_key_error(duplicate_key_message(m_category, r.get_row()));
+	}
 }
 
-row *category_index::find(row *k) const
+// Rows with a key equal to a row preceding it in the category are not
+// added to the index but are returned in duplicates instead.
+
+category_index::category_index(category *cat, std::vector<row *> &duplicates)
+	: m_category(*cat)
+	, m_key_normalizer(m_category)
 {
-	const entry *r = m_root;
-	while (r != nullptr)
+	reserve(m_category.size());
+
+	for (auto r : m_category)
 	{
-		int d = m_row_comparator(k, r->m_row);
-		if (d < 0)
-			r = r->m_left;
-		else if (d > 0)
-			r = r->m_right;
-		else
-			break;
+		if (not try_insert(r.get_row()))
+			duplicates.push_back(r.get_row());
 	}
-
-	return r ? r->m_row : nullptr;
 }
 
-row *category_index::find_by_value(row_initializer k) const
+void category_index::reserve(size_t n)
 {
-	// sort the values in k first
+	// keep the load factor below one half, erased entries are not in
+	// the hash table
+	size_t capacity = 16;
+	while (capacity < 2 * n)
+		capacity *= 2;
 
-	row_initializer k2;
-	for (auto &f : m_category.key_field_indices())
-	{
-		auto fld = m_category.get_column_name(f);
+	if (capacity <= m_slots.size())
+		return;
 
-		auto ki = find_if(k.begin(), k.end(), [&fld](auto &i) { return i.name() == fld; });
-		if (ki == k.end())
-			k2.emplace_back(fld, "");
-		else
-			k2.emplace_back(*ki);
-	}
+	m_entries.reserve(n + m_erased);
+	m_order.reserve(n + m_erased);
+	m_slots.assign(capacity, kEmptySlot);
 
-	const entry *r = m_root;
-	while (r != nullptr)
+	for (uint32_t ix = 0; ix < m_entries.size(); ++ix)
 	{
-		int d = m_row_comparator(k2, r->m_row);
-		if (d < 0)
-			r = r->m_left;
-		else if (d > 0)
-			r = r->m_right;
-		else
-			break;
+		if (m_entries[ix].m_row == nullptr)
+			continue;
+
+		size_t i = m_entries[ix].m_hash & mask();
+		while (m_slots[i] != kEmptySlot)
+			i = (i + 1) & mask();
+		m_slots[i] = ix;
 	}
+}
+
+row *category_index::find(row *k) const
+{
+	if (m_slots.empty())
+		return nullptr;
+
+	auto key = m_key_normalizer(k);
+	auto i = find_slot(key, hash(key));
+
+	return m_slots[i] != kEmptySlot ? m_entries[m_slots[i]].m_row : nullptr;
+}
 
-	return r ? r->m_row : nullptr;
+row *category_index::find_by_value(row_initializer k) const
+{
+	if (m_slots.empty())
+		return nullptr;
+
+	auto key = m_key_normalizer(k);
+	auto i = find_slot(key, hash(key));
+
+	return m_slots[i] != kEmptySlot ? m_entries[m_slots[i]].m_row : nullptr;
 }
 
 void category_index::insert(row *k)
 {
-	m_root = insert(m_root, k);
-	m_root->m_red = false;
+	if (not try_insert(k))
+		throw duplicate_key_error(duplicate_key_message(m_category, k));
 }
 
-category_index::entry *category_index::insert(entry *h, row *v)
+bool category_index::try_insert(row *k)
 {
-	if (h == nullptr)
-		return new entry(v);
+	if (m_entries.size() >= std::numeric_limits<uint32_t>::max() - 1)
+		throw std::runtime_error("Too many rows in category " + m_category.name());
 
-	int d = m_row_comparator(v, h->m_row);
-	if (d < 0)
-		h->m_left = insert(h->m_left, v);
-	else if (d > 0)
-		h->m_right = insert(h->m_right, v);
-	else
-	{
-		row_handle rh(m_category, *v);
+	reserve(size() + 1);
 
-		std::ostringstream os;
-		for (auto col : m_category.key_fields())
-		{
-			if (rh[col])
-				os << col << ": " << std::quoted(rh[col].text()) << "; ";
-		}
+	auto key = m_key_normalizer(k);
+	auto h = hash(key);
 
-		throw duplicate_key_error("Duplicate Key violation, cat: " + m_category.name() + " values: " + os.str());
-	}
+	auto i = find_slot(key, h);
+	if (m_slots[i] != kEmptySlot)
+		return false;
 
-	if (is_red(h->m_right) and not is_red(h->m_left))
-		h = rotateLeft(h);
+	auto ix = static_cast<uint32_t>(m_entries.size());
 
-	if (is_red(h->m_left) and is_red(h->m_left->m_left))
-		h = rotateRight(h);
+	// Rows added in order of their keys, which is common, keep the order sorted
+	if (m_sorted == m_order.size() and (m_order.empty() or m_entries[m_order.back()].m_key < key))
+		++m_sorted;
 
-	if (is_red(h->m_left) and is_red(h->m_right))
-		flipColour(h);
+	m_slots[i] = ix;
+	m_order.push_back(ix);
+	m_entries.push_back({ k, h, std::move(key) });
 
-	return h;
+	return true;
 }
 
 void category_index::erase(row *k)
 {
 	assert(find(k) == k);
 
-	m_root = erase(m_root, k);
-	if (m_root != nullptr)
-		m_root->m_red = false;
-}
+	if (m_slots.empty())
+		return;
 
-category_index::entry *category_index::erase(entry *h, row *k)
-{
-	if (m_row_comparator(k, h->m_row) < 0)
-	{
-		if (h->m_left != nullptr)
-		{
-			if (not is_red(h->m_left) and not is_red(h->m_left->m_left))
-				h = move_red_left(h);
+	auto key = m_key_normalizer(k);
+	auto i = find_slot(key, hash(key));
 
-			h->m_left = erase(h->m_left, k);
-		}
-	}
-	else
+	if (m_slots[i] == kEmptySlot or m_entries[m_slots[i]].m_row != k)
 	{
-		if (is_red(h->m_left))
-			h = rotateRight(h);
+		// The key was changed without updating the index
+		auto e = std::find_if(m_entries.begin(), m_entries.end(), [k](const entry &e) { return e.m_row == k; });
+		if (e == m_entries.end())
+			return;
+		i = find_entry_slot(static_cast<uint32_t>(e - m_entries.begin()));
+	}
 
-		if (m_row_comparator(k, h->m_row) == 0 and h->m_right == nullptr)
-		{
-			delete h;
-			return nullptr;
-		}
+	uint32_t ix = m_slots[i];
 
-		if (h->m_right != nullptr)
-		{
-			if (not is_red(h->m_right) and not is_red(h->m_right->m_left))
-				h = move_red_right(h);
+	// Move slots back into the hole, if their probe sequence passes it
+	for (size_t j = (i + 1) & mask(); m_slots[j] != kEmptySlot; j = (j + 1) & mask())
+	{
+		size_t home = m_entries[m_slots[j]].m_hash & mask();
 
-			if (m_row_comparator(k, h->m_row) == 0)
-			{
-				h->m_row = find_min(h->m_right)->m_row;
-				h->m_right = erase_min(h->m_right);
-			}
-			else
-				h->m_right = erase(h->m_right, k);
-		}
+		bool stays = i <= j ? (i < home and home <= j) : (i < home or home <= j);
+		if (stays)
+			continue;
+
+		m_slots[i] = m_slots[j];
+		i = j;
 	}
 
-	return fix_up(h);
+	m_slots[i] = kEmptySlot;
+
+	// The entry stays in place, in m_order, until there are many of these
+	m_entries[ix].m_row = nullptr;
+	++m_erased;
+
+	if (m_erased > 64 and m_erased > m_entries.size() / 2)
+		compact();
 }
 
-size_t category_index::size() const
+void category_index::sort_order()
 {
-	std::stack<entry *> s;
-	s.push(m_root);
+	if (m_sorted == m_order.size())
+		return;
 
-	size_t result = 0;
+	auto less = [this](uint32_t a, uint32_t b)
+	{ return m_entries[a].m_key < m_entries[b].m_key; };
 
-	while (not s.empty())
-	{
-		entry *e = s.top();
-		s.pop();
+	auto mid = m_order.begin() + m_sorted;
+	std::sort(mid, m_order.end(), less);
+	std::inplace_merge(m_order.begin(), mid, m_order.end(), less);
 
-		if (e == nullptr)
-			continue;
+	m_sorted = m_order.size();
+}
 
-		++result;
+void category_index::compact()
+{
+	sort_order();
+
+	// Keep the entries in order, the order then simply counts up
+	std::vector<entry> entries;
+	entries.reserve(size());
 
-		s.push(e->m_left);
-		s.push(e->m_right);
+	for (auto ix : m_order)
+	{
+		if (m_entries[ix].m_row != nullptr)
+			entries.push_back(std::move(m_entries[ix]));
 	}
 
-	return result;
-}
+	m_entries = std::move(entries);
+	m_erased = 0;
 
-// --------------------------------------------------------------------
+	m_order.resize(m_entries.size());
+	std::iota(m_order.begin(), m_order.end(), 0);
+	m_sorted = m_order.size();
 
-category::category(std::string_view name)
-	: m_name(name)
-{
+	m_slots.clear();
+	reserve(m_entries.size());
 }
 
-category::category(const category &rhs)
-	: m_name(rhs.m_name)
-	, m_columns(rhs.m_columns)
-	, m_validator(rhs.m_validator)
-	, m_cat_validator(rhs.m_cat_validator)
-	, m_cascade(rhs.m_cascade)
+std::tuple<row *, row *> category_index::reorder()
 {
-	for (auto r = rhs.m_head; r != nullptr; r = r->m_next)
-		insert_impl(end(), clone_row(*r));
+	sort_order();
 
-	if (m_cat_validator != nullptr and m_index == nullptr)
-		m_index = new category_index(this);
-}
+	row *head = nullptr, *tail = nullptr;
 
-category::category(category &&rhs)
-	: m_name(std::move(rhs.m_name))
-	, m_columns(std::move(rhs.m_columns))
-	, m_validator(rhs.m_validator)
-	, m_cat_validator(rhs.m_cat_validator)
-	, m_parent_links(std::move(rhs.m_parent_links))
-	, m_child_links(std::move(rhs.m_child_links))
-	, m_cascade(rhs.m_cascade)
-	, m_index(rhs.m_index)
-	, m_head(rhs.m_head)
-	, m_tail(rhs.m_tail)
-{
-	rhs.m_head = nullptr;
-	rhs.m_tail = nullptr;
-	rhs.m_index = nullptr;
+	for (auto ix : m_order)
+	{
+		auto r = m_entries[ix].m_row;
+		if (r == nullptr)
+			continue;
+
+		if (tail == nullptr)
+			head = r;
+		else
+			tail->m_next = r;
+		tail = r;
+	}
+
+	if (tail != nullptr)
+		tail->m_next = nullptr;
+
+	return { head, tail };
+}
+
+// --------------------------------------------------------------------
+//
+//	A secondary index on arbitrary columns of a category, created with
+//	category::create_index. Rows with the same values are allowed. The
+//	normalized keys are kept in a multimap, the rows with a key starting
+//	with the values for the first columns are next to each other and so
+//	are the rows with numbers in a range for the next column.
+
+class secondary_index
+{
+  public:
+	secondary_index(category &cat, const std::vector<uint16_t> &columns);
+
+	const std::vector<uint16_t> &get_columns() const
+	{
+		return m_columns;
+	}
+
+	bool covers(uint16_t column) const
+	{
+		return std::find(m_columns.begin(), m_columns.end(), column) != m_columns.end();
+	}
+
+	void insert(row *r);
+
+	// Remove \a r, returns false if it was not in this index
+	bool erase(row *r);
+
+	void clear();
+
+	// Return the number of terms this index can use, zero if it cannot be used
+	size_t usable(const detail::index_terms &terms) const;
+
+	// Return the estimated fraction of the rows in \a cat that find returns
+	double selectivity(const category &cat, const detail::index_terms &terms) const;
+
+	// Add the rows that may match the terms to \a rows, in no particular order
+	void find(const detail::index_terms &terms, std::vector<row *> &rows) const;
+
+  private:
+	// Whether \a v can be parsed into an integer that differs from the
+	// number it is parsed into as double, or parsed as only one of these
+	static bool is_inexact_integer(std::string_view v);
+
+	// Return the intersection of the ranges in terms for column \a nr
+	std::optional<detail::index_range> get_range(const detail::index_terms &terms, size_t nr) const;
+
+	void count_inexact(const row *r, int delta);
+
+	std::vector<uint16_t> m_columns;
+	key_normalizer m_key_normalizer;
+	std::multimap<std::string, row *> m_entries;
+
+	// per column, the number of values for which is_inexact_integer is true
+	std::vector<size_t> m_inexact;
+};
+
+secondary_index::secondary_index(category &cat, const std::vector<uint16_t> &columns)
+	: m_columns(columns)
+	, m_key_normalizer(cat, columns)
+	, m_inexact(columns.size(), 0)
+{
+	for (auto r : cat)
+		insert(r.get_row());
+}
+
+void secondary_index::insert(row *r)
+{
+	m_entries.emplace(m_key_normalizer(r), r);
+	count_inexact(r, 1);
+}
+
+bool secondary_index::erase(row *r)
+{
+	auto [b, e] = m_entries.equal_range(m_key_normalizer(r));
+
+	auto i = std::find_if(b, e, [r](auto &entry) { return entry.second == r; });
+	if (i == e)
+		return false;
+
+	m_entries.erase(i);
+	count_inexact(r, -1);
+
+	return true;
+}
+
+void secondary_index::clear()
+{
+	m_entries.clear();
+	std::fill(m_inexact.begin(), m_inexact.end(), 0);
+}
+
+void secondary_index::count_inexact(const row *r, int delta)
+{
+	for (size_t nr = 0; nr < m_columns.size(); ++nr)
+	{
+		auto iv = r->get(m_columns[nr]);
+		if (iv != nullptr and is_inexact_integer(iv->text()))
+			m_inexact[nr] += delta;
+	}
+}
+
+bool secondary_index::is_inexact_integer(std::string_view v)
+{
+	bool result = false;
+
+	if (not v.empty())
+	{
+		int32_t i;
+		auto ri = std::from_chars(v.data(), v.data() + v.length(), i);
+
+		double d;
+		auto rd = selected_charconv<double>::from_chars(v.data(), v.data() + v.length(), d);
+
+		if (ri.ec == std::errc() or rd.ec == std::errc())
+			result = ri.ec != std::errc() or ri.ptr != v.data() + v.length() or rd.ec != std::errc() or d != i;
+	}
+
+	return result;
+}
+
+std::optional<detail::index_range> secondary_index::get_range(const detail::index_terms &terms, size_t nr) const
+{
+	std::optional<detail::index_range> result;
+
+	if (m_key_normalizer.get_type(nr) == DDL_PrimitiveType::Numb)
+	{
+		for (auto &[ix, range] : terms.m_ranges)
+		{
+			if (ix != m_columns[nr] or (range.m_integral and m_inexact[nr] > 0))
+				continue;
+
+			if (not result.has_value())
+				result = range;
+			else
+			{
+				result->m_lower = std::max(result->m_lower, range.m_lower);
+				result->m_upper = std::min(result->m_upper, range.m_upper);
+				result->m_not_a_number = result->m_not_a_number and range.m_not_a_number;
+			}
+		}
+	}
+
+	return result;
+}
+
+size_t secondary_index::usable(const detail::index_terms &terms) const
+{
+	size_t result = 0;
+
+	for (auto column : m_columns)
+	{
+		if (std::find_if(terms.m_equals.begin(), terms.m_equals.end(),
+				[column](auto &t) { return std::get<0>(t) == column; }) == terms.m_equals.end())
+			break;
+		++result;
+	}
+
+	if (result < m_columns.size() and get_range(terms, result).has_value())
+		++result;
+
+	return result;
+}
+
+double secondary_index::selectivity(const category &cat, const detail::index_terms &terms) const
+{
+	double result = 1;
+	size_t nr = 0;
+
+	for (; nr < m_columns.size(); ++nr)
+	{
+		auto t = std::find_if(terms.m_equals.begin(), terms.m_equals.end(),
+			[column = m_columns[nr]](auto &t) { return std::get<0>(t) == column; });
+		if (t == terms.m_equals.end())
+			break;
+
+		auto &[column, value, or_empty] = *t;
+		auto stats = cat.get_column_statistics(column);
+
+		result *= (value.empty() ? 0 : stats.equal_fraction()) +
+		          (value.empty() or or_empty ? stats.m_empty : 0);
+	}
+
+	// without statistics on the values, assume a third of the rows is in range
+	if (nr < m_columns.size() and get_range(terms, nr).has_value())
+		result /= 3;
+
+	return result;
+}
+
+void secondary_index::find(const detail::index_terms &terms, std::vector<row *> &rows) const
+{
+	// The keys for the values of the leading columns, there is more than
+	// one if empty values match as well
+	std::vector<std::string> prefixes{ std::string{} };
+	size_t nr = 0;
+
+	for (; nr < m_columns.size(); ++nr)
+	{
+		auto t = std::find_if(terms.m_equals.begin(), terms.m_equals.end(),
+			[column = m_columns[nr]](auto &t) { return std::get<0>(t) == column; });
+		if (t == terms.m_equals.end())
+			break;
+
+		auto &[column, value, or_empty] = *t;
+
+		std::vector<std::string_view> values;
+		if (not value.empty())
+			values.push_back(value);
+		if (or_empty)
+			values.insert(values.end(), { "", ".", "?" });
+
+		std::vector<std::string> next;
+		for (auto &prefix : prefixes)
+		{
+			for (auto v : values)
+			{
+				next.push_back(prefix);
+				m_key_normalizer.append(next.back(), nr, v);
+			}
+		}
+
+		std::swap(prefixes, next);
+	}
+
+	// add the rows starting at key b up to and including the ones with a key starting with e
+	auto add = [this, &rows](const std::string &b, const std::string &e)
+	{
+		for (auto i = m_entries.lower_bound(b); i != m_entries.end() and i->first.compare(0, e.length(), e) <= 0; ++i)
+			rows.push_back(i->second);
+	};
+
+	auto range = nr < m_columns.size() ? get_range(terms, nr) : std::nullopt;
+
+	for (auto &prefix : prefixes)
+	{
+		if (not range.has_value())
+		{
+			add(prefix, prefix);
+			continue;
+		}
+
+		auto number_key = [&prefix](double d)
+		{
+			std::string key = prefix;
+			key_normalizer::append_number(key, d);
+			return key;
+		};
+
+		auto inf = std::numeric_limits<double>::infinity();
+
+		if (range->m_not_a_number)
+			add(prefix + char(key_normalizer::kEmpty), prefix + char(key_normalizer::kText));
+
+		add(number_key(range->m_lower), number_key(range->m_upper));
+
+		// NaN compares equal to any number, these are sorted before -inf or after inf
+		add(prefix + char(key_normalizer::kNumber), number_key(-inf));
+		add(number_key(inf), prefix + char(key_normalizer::kNumber));
+	}
+}
+
+// --------------------------------------------------------------------
+
+category::category()
+	: m_pool(new row_pool)
+{
+}
+
+category::category(std::string_view name)
+	: m_name(name)
+	, m_pool(new row_pool)
+{
+}
+
+category::category(const category &rhs)
+	: m_name(rhs.m_name)
+	, m_columns(rhs.m_columns)
+	, m_column_index(rhs.m_column_index)
+	, m_validator(rhs.m_validator)
+	, m_cat_validator(rhs.m_cat_validator)
+	, m_cascade(rhs.m_cascade)
+	, m_pool(new row_pool)
+{
+	// the rows in rhs are known to be unique, build the index in one go
+	m_deferred_index = true;
+
+	for (auto r = rhs.m_head; r != nullptr; r = r->m_next)
+		insert_impl(end(), clone_row(*r));
+
+	m_deferred_index = false;
+
+	if (m_cat_validator != nullptr and m_index == nullptr)
+		m_index = new category_index(this);
+
+	for (auto ix : rhs.m_secondary_indices)
+		m_secondary_indices.push_back(new secondary_index(*this, ix->get_columns()));
+}
+
+category::category(category &&rhs)
+	: m_name(std::move(rhs.m_name))
+	, m_columns(std::move(rhs.m_columns))
+	, m_column_index(std::move(rhs.m_column_index))
+	, m_validator(rhs.m_validator)
+	, m_cat_validator(rhs.m_cat_validator)
+	, m_parent_links(std::move(rhs.m_parent_links))
+	, m_child_links(std::move(rhs.m_child_links))
+	, m_cascade(rhs.m_cascade)
+	, m_index(rhs.m_index)
+	, m_pool(rhs.m_pool)
+	, m_column_store(rhs.m_column_store)
+	, m_secondary_indices(std::move(rhs.m_secondary_indices))
+	, m_head(rhs.m_head)
+	, m_tail(rhs.m_tail)
+	, m_size(rhs.m_size)
+	, m_ordinals_valid(rhs.m_ordinals_valid)
+	, m_statistics(std::move(rhs.m_statistics))
+	, m_statistics_size(rhs.m_statistics_size)
+{
+	rhs.m_secondary_indices.clear();
+	rhs.m_head = nullptr;
+	rhs.m_tail = nullptr;
+	rhs.m_index = nullptr;
+	rhs.m_pool = nullptr;
+	rhs.m_column_store = nullptr;
+	rhs.m_size = 0;
+
+	// conditions prepared for rhs refer to rows it no longer has
+	rhs.discard_column_store();
 }
 
 category &category::operator=(const category &rhs)
 {
 	if (this != &rhs)
 	{
+		discard_column_store();
+
 		if (not empty())
 			clear();
 
 		m_name = rhs.m_name;
 		m_columns = rhs.m_columns;
+		m_column_index = rhs.m_column_index;
+		++m_column_layout;
 		m_cascade = rhs.m_cascade;
 
 		m_validator = nullptr;
@@ -557,6 +1028,10 @@ category &category::operator=(const category &rhs)
 		delete m_index;
 		m_index = nullptr;
 
+		for (auto ix : m_secondary_indices)
+			delete ix;
+		m_secondary_indices.clear();
+
 		for (auto r = rhs.m_head; r != nullptr; r = r->m_next)
 			insert_impl(cend(), clone_row(*r));
 
@@ -565,6 +1040,9 @@ category &category::operator=(const category &rhs)
 
 		if (m_cat_validator != nullptr and m_index == nullptr)
 			m_index = new category_index(this);
+
+		for (auto ix : rhs.m_secondary_indices)
+			m_secondary_indices.push_back(new secondary_index(*this, ix->get_columns()));
 	}
 
 	return *this;
@@ -576,6 +1054,9 @@ category &category::operator=(category &&rhs)
 	{
 		m_name = std::move(rhs.m_name);
 		m_columns = std::move(rhs.m_columns);
+		m_column_index = std::move(rhs.m_column_index);
+		++m_column_layout;
+		++rhs.m_column_layout;
 		m_cascade = rhs.m_cascade;
 		m_validator = rhs.m_validator;
 		m_cat_validator = rhs.m_cat_validator;
@@ -583,8 +1064,20 @@ category &category::operator=(category &&rhs)
 		m_child_links = rhs.m_child_links;
 
 		std::swap(m_index, rhs.m_index);
+		std::swap(m_pool, rhs.m_pool);
+		std::swap(m_column_store, rhs.m_column_store);
+		std::swap(m_secondary_indices, rhs.m_secondary_indices);
 		std::swap(m_head, rhs.m_head);
 		std::swap(m_tail, rhs.m_tail);
+		std::swap(m_size, rhs.m_size);
+		std::swap(m_ordinals_valid, rhs.m_ordinals_valid);
+		std::swap(m_statistics, rhs.m_statistics);
+		std::swap(m_statistics_size, rhs.m_statistics_size);
+
+		// the rows changed hands, conditions prepared for either category
+		// should look them up again
+		discard_column_store();
+		rhs.discard_column_store();
 	}
 
 	return *this;
@@ -592,7 +1085,13 @@ category &category::operator=(category &&rhs)
 
 category::~category()
 {
-	clear();
+	delete m_index;
+	delete m_saved_index;
+	delete m_pool;
+	delete m_column_store;
+
+	for (auto ix : m_secondary_indices)
+		delete ix;
 }
 
 // --------------------------------------------------------------------
@@ -649,6 +1148,8 @@ void category::set_validator(const validator *v, datablock &db)
 		m_index = nullptr;
 	}
 
+	discard_saved_index();
+
 	if (m_validator != nullptr)
 	{
 		m_cat_validator = m_validator->get_validator_for_category(m_name);
@@ -668,7 +1169,9 @@ void category::set_validator(const validator *v, datablock &db)
 				}
 			}
 
-			if (missing.empty())
+			if (m_deferred_index)
+				; // index will be built when the bulk insert is committed
+			else if (missing.empty())
 				m_index = new category_index(this);
 			else if (VERBOSE > 0)
 				std::cerr << "Cannot construct index since the key field" << (missing.size() > 1 ? "s" : "") << " "
@@ -678,8 +1181,16 @@ void category::set_validator(const validator *v, datablock &db)
 	else
 		m_cat_validator = nullptr;
 
-	for (auto &&[column, cv] : m_columns)
-		cv = m_cat_validator ? m_cat_validator->get_validator_for_item(column) : nullptr;
+	for (auto &col : m_columns)
+		col.m_validator = m_cat_validator ? m_cat_validator->get_validator_for_item(col.m_name) : nullptr;
+
+	// the types of the columns may have changed
+	for (auto &ix : m_secondary_indices)
+	{
+		auto columns = ix->get_columns();
+		delete ix;
+		ix = new secondary_index(*this, columns);
+	}
 
 	update_links(db);
 }
@@ -753,7 +1264,7 @@ bool category::is_valid() const
 		result = false;
 	}
 
-	if (m_cat_validator->m_keys.empty() == false and m_index == nullptr)
+	if (m_cat_validator->m_keys.empty() == false and m_index == nullptr and not m_deferred_index)
 	{
 		std::set<std::string> missing;
 
@@ -889,6 +1400,73 @@ bool category::validate_links() const
 	return result;
 }
 
+void category::validate_structure(validation_report &report) const
+{
+	if (m_validator == nullptr)
+		throw std::runtime_error("no Validator specified");
+
+	if (empty())
+		return;
+
+	auto add = [&](std::string_view item, std::string message)
+	{
+		report.push_back({ {}, m_name, std::string{ item }, std::string::npos, std::move(message) });
+	};
+
+	if (m_cat_validator == nullptr)
+	{
+		add({}, "undefined category " + m_name);
+		return;
+	}
+
+	auto mandatory = m_cat_validator->m_mandatory_fields;
+
+	for (auto &col : m_columns)
+	{
+		if (m_cat_validator->get_validator_for_item(col.m_name) == nullptr)
+			add(col.m_name, "Field " + col.m_name + " is not valid in category " + m_name);
+
+		mandatory.erase(col.m_name);
+	}
+
+	for (auto &item : mandatory)
+		add(item, "missing mandatory field " + item + " for category " + m_name);
+
+	if (m_cat_validator->m_keys.empty() == false and m_index == nullptr and not m_deferred_index)
+		add({}, "In category " + m_name + " the index is missing, likely due to missing key fields");
+}
+
+void category::validate_values(validation_report &report, const_iterator b, const_iterator e, std::size_t row_nr) const
+{
+	if (m_cat_validator == nullptr)
+		return;
+
+	std::string message;
+
+	for (auto i = b; i != e; ++i, ++row_nr)
+	{
+		const row *r = (*i).get_row();
+
+		for (uint16_t ix = 0; ix < static_cast<uint16_t>(m_columns.size()); ++ix)
+		{
+			const auto &column = m_columns[ix].m_name;
+			auto iv = m_columns[ix].m_validator;
+
+			if (iv == nullptr)
+				continue;
+
+			auto v = r->get(ix);
+			if (v != nullptr and *v)
+			{
+				if (not iv->validate_value(v->text(), message))
+					report.push_back({ {}, m_name, column, row_nr, std::move(message) });
+			}
+			else if (iv->m_mandatory)
+				report.push_back({ {}, m_name, column, row_nr, "missing mandatory field " + column + " for category " + m_name });
+		}
+	}
+}
+
 // --------------------------------------------------------------------
 
 row_handle category::operator[](const key_type &key)
@@ -1066,6 +1644,14 @@ category::iterator category::erase(iterator pos)
 	if (m_index != nullptr)
 		m_index->erase(r);
 
+	for (auto ix : m_secondary_indices)
+		ix->erase(r);
+
+	discard_saved_index();
+	discard_column_store();
+
+	row *prev = nullptr;
+
 	if (r == m_head)
 	{
 		m_head = m_head->m_next;
@@ -1073,17 +1659,22 @@ category::iterator category::erase(iterator pos)
 	}
 	else
 	{
-		for (auto pi = m_head; pi != nullptr; pi = pi->m_next)
+		for (prev = m_head; prev != nullptr; prev = prev->m_next)
 		{
-			if (pi->m_next == r)
+			if (prev->m_next == r)
 			{
-				pi->m_next = r->m_next;
+				prev->m_next = r->m_next;
 				r->m_next = nullptr;
 				break;
 			}
 		}
 	}
 
+	if (r == m_tail)
+		m_tail = prev;
+
+	--m_size;
+
 	// links are created based on the _pdbx_item_linked_group_list entries
 	// in mmcif_pdbx.dic dictionary.
 	//
@@ -1100,15 +1691,6 @@ category::iterator category::erase(iterator pos)
 
 	delete_row(r);
 
-	// reset mTail, if needed
-	if (r == m_tail)
-	{
-		m_tail = m_head;
-		if (m_tail != nullptr)
-			while (m_tail->m_next != nullptr)
-				m_tail = m_tail->m_next;
-	}
-
 	return result;
 }
 
@@ -1141,33 +1723,73 @@ size_t category::erase(condition &&cond, std::function<void(row_handle)> &&visit
 {
 	size_t result = 0;
 
-	cond.prepare(*this);
+	// the condition may have been prepared already, see erase with an execution policy
+	if (not cond.prepared())
+		cond.prepare(*this);
 
 	std::map<category *, condition> potential_orphans;
 
-	auto ri = begin();
-	while (ri != end())
+	auto erase_row = [&](iterator ri)
 	{
-		if (cond(*ri))
+		if (visit)
+			visit(*ri);
+
+		for (auto &&[childCat, link] : m_child_links)
 		{
-			if (visit)
-				visit(*ri);
+			auto ccond = get_children_condition(*ri, *childCat);
+			if (not ccond)
+				continue;
+			potential_orphans[childCat] = std::move(potential_orphans[childCat]) or std::move(ccond);
+		}
 
-			for (auto &&[childCat, link] : m_child_links)
-			{
-				auto ccond = get_children_condition(*ri, *childCat);
-				if (not ccond)
-					continue;
-				potential_orphans[childCat] = std::move(potential_orphans[childCat]) or std::move(ccond);
-			}
+		save_value sv(m_validator);
+
+		++result;
+		return erase(ri);
+	};
 
-			save_value sv(m_validator);
+	// erasing a row can cascade to other rows of this category if it links to itself
+	bool self_linked = std::find_if(m_child_links.begin(), m_child_links.end(),
+						   [this](const link &l) { return l.linked == this; }) != m_child_links.end();
 
-			ri = erase(ri);
-			++result;
+	if (auto cs = cond.candidates(); cs != nullptr)
+	{
+		for (auto r : *cs)
+		{
+			if (cond.candidate_matches({ *this, *r }))
+				erase_row(iterator(*this, r));
+		}
+	}
+	else if (auto program = cond.program(); program != nullptr and not self_linked)
+	{
+		// evaluate the condition for a batch of rows, then erase the matches
+		const row *rows[detail::condition_program::kBatchSize];
+		detail::condition_program::selection sel;
+
+		for (const row *r = m_head; r != nullptr;)
+		{
+			auto n = program->fill(r, rows);
+			program->evaluate(rows, n, sel);
+
+			r = rows[n - 1]->m_next;
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (sel[i / 64] & (uint64_t(1) << (i % 64)))
+					erase_row(iterator(*this, const_cast<row *>(rows[i])));
+			}
+		}
+	}
+	else
+	{
+		auto ri = begin();
+		while (ri != end())
+		{
+			if (cond(*ri))
+				ri = erase_row(ri);
+			else
+				++ri;
 		}
-		else
-			++ri;
 	}
 
 	for (auto &&[childCat, condition] : potential_orphans)
@@ -1178,18 +1800,28 @@ size_t category::erase(condition &&cond, std::function<void(row_handle)> &&visit
 
 void category::clear()
 {
-	auto i = m_head;
-	while (i != nullptr)
+	// Deleting the pool releases all rows at once
+	if (m_head != nullptr)
 	{
-		auto t = i;
-		i = i->m_next;
-		delete_row(t);
+		delete m_pool;
+		m_pool = new row_pool;
 	}
 
 	m_head = m_tail = nullptr;
+	m_size = 0;
+	m_ordinals_valid = true;
 
 	delete m_index;
 	m_index = nullptr;
+
+	for (auto ix : m_secondary_indices)
+		ix->clear();
+
+	m_statistics.clear();
+	m_statistics_size = 0;
+
+	discard_saved_index();
+	discard_column_store();
 }
 
 void category::erase_orphans(condition &&cond, category &parent)
@@ -1198,13 +1830,13 @@ void category::erase_orphans(condition &&cond, category &parent)
 
 	cond.prepare(*this);
 
-	for (auto r : *this)
+	auto check = [&](row_handle r)
 	{
 		if (not cond(r))
-			continue;
+			return;
 		
 		if (parent.exists(get_parents_condition(r, parent)))
-			continue;
+			return;
 
 		if (VERBOSE > 1)
 		{
@@ -1217,6 +1849,17 @@ void category::erase_orphans(condition &&cond, category &parent)
 		}
 		
 		remove.emplace_back(r.m_row);
+	};
+
+	if (auto cs = cond.candidates(); cs != nullptr)
+	{
+		for (auto r : *cs)
+			check({ *this, *r });
+	}
+	else
+	{
+		for (auto r : *this)
+			check(r);
 	}
 
 	for (auto r : remove)
@@ -1234,7 +1877,7 @@ std::string category::get_unique_id(std::function<std::string(int)> generator)
 	std::string result = generator(static_cast<int>(m_last_unique_num++));
 
 	std::string id_tag = "id";
-	if (m_cat_validator != nullptr and m_cat_validator->m_keys.size() == 1)
+	if (m_cat_validator != nullptr and m_cat_validator->m_keys.size() == 1 and not m_deferred_index)
 	{
 		if (m_index == nullptr and m_cat_validator != nullptr)
 			m_index = new category_index(this);
@@ -1392,9 +2035,11 @@ void category::update_value(const std::vector<row_handle> &rows, std::string_vie
 void category::update_value(row *row, uint16_t column, std::string_view value, bool updateLinked, bool validate)
 {
 	// make sure we have an index, if possible
-	if (m_index == nullptr and m_cat_validator != nullptr)
+	if (m_index == nullptr and m_cat_validator != nullptr and not m_deferred_index)
 		m_index = new category_index(this);
 
+	discard_column_store();
+
 	auto &col = m_columns[column];
 
 	std::string_view oldValue;
@@ -1424,16 +2069,31 @@ void category::update_value(row *row, uint16_t column, std::string_view value, b
 			m_index->erase(row);
 	}
 
+	// the index saved by a bulk_inserter cannot be updated, it will be rebuilt instead
+	if (m_saved_index != nullptr and key_field_indices().count(column))
+		discard_saved_index();
+
+	// take the row out of the secondary indices containing this column
+	std::vector<secondary_index *> indices;
+	for (auto ix : m_secondary_indices)
+	{
+		if (ix->covers(column) and ix->erase(row))
+			indices.push_back(ix);
+	}
+
 	// first remove old value with cix
 	if (ival != nullptr)
-		row->remove(column);
+		row->remove(column, get_arena());
 
 	if (not value.empty())
-		row->append(column, { value });
+		store_value(row, column, value);
 
 	if (reinsert)
 		m_index->insert(row);
 
+	for (auto ix : indices)
+		ix->insert(row);
+
 	// see if we need to update any child categories that depend on this value
 	auto iv = col.m_validator;
 	if (updateLinked and iv != nullptr /*and m_cascade*/)
@@ -1529,7 +2189,7 @@ row *category::clone_row(const row &r)
 			if (not i)
 				continue;
 			
-			result->append( ix, { i.text() });
+			store_value(result, ix, i.text());
 		}
 	}
 	catch (...)
@@ -1541,16 +2201,122 @@ row *category::clone_row(const row &r)
 	return result;
 }
 
-void category::delete_row(row *r)
+row *category::create_row()
 {
-	if (r != nullptr)
+	if (m_pool == nullptr)
+		m_pool = new row_pool;
+
+	return m_pool->allocate(static_cast<uint16_t>(m_columns.size()));
+}
+
+string_arena &category::get_arena()
+{
+	if (m_pool == nullptr)
+		m_pool = new row_pool;
+
+	return m_pool->get_arena();
+}
+
+category::row_allocator::row_allocator(category &cat)
+	: m_category(cat)
+	, m_pool(new row_pool)
+{
+}
+
+category::row_allocator::~row_allocator()
+{
+	delete m_pool;
+}
+
+row *category::row_allocator::create_row()
+{
+	return m_pool->allocate(static_cast<uint16_t>(m_category.m_columns.size()));
+}
+
+string_arena &category::row_allocator::get_arena()
+{
+	return m_pool->get_arena();
+}
+
+void category::merge(row_allocator &allocator)
+{
+	assert(&allocator.m_category == this);
+
+	if (m_pool == nullptr)
+		m_pool = new row_pool;
+
+	m_pool->merge(std::move(*allocator.m_pool));
+}
+
+void category::store_value(row *r, uint16_t column, std::string_view value)
+{
+	auto &arena = get_arena();
+
+	if (m_columns[column].m_interned)
+		r->intern(column, value, m_pool->get_string_table(), arena);
+	else
+		r->append(column, value, arena);
+}
+
+const string_table *category::get_string_table(uint16_t column_ix) const
+{
+	return column_ix < m_columns.size() and m_columns[column_ix].m_interned ? &m_pool->get_string_table() : nullptr;
+}
+
+void category::intern_column(std::string_view column_name)
+{
+	auto ix = add_column(column_name);
+	if (m_columns[ix].m_interned)
+		return;
+
+	m_columns[ix].m_interned = true;
+
+	auto &arena = get_arena();
+	auto &table = m_pool->get_string_table();
+
+	for (auto r = m_head; r != nullptr; r = r->m_next)
 	{
-		row_allocator_type ra(get_allocator());
-		row_allocator_traits::destroy(ra, r);
-		row_allocator_traits::deallocate(ra, r, 1);
+		auto iv = r->get(ix);
+		if (iv == nullptr or not *iv)
+			continue;
+
+		item_value v(iv->text(), table);
+		iv->release(arena);
+		*iv = std::move(v);
+	}
+}
+
+void category::intern_repeated_values(std::size_t max_distinct)
+{
+	for (uint16_t ix = 0; ix < m_columns.size(); ++ix)
+	{
+		if (m_columns[ix].m_interned)
+			continue;
+
+		std::unordered_set<std::string_view> values;
+		std::size_t count = 0;
+
+		for (auto r = m_head; r != nullptr and values.size() <= max_distinct; r = r->m_next)
+		{
+			auto iv = r->get(ix);
+			if (iv == nullptr or not *iv)
+				continue;
+
+			values.insert(iv->text());
+			++count;
+		}
+
+		if (not values.empty() and values.size() <= max_distinct and values.size() * 4 <= count)
+			intern_column(m_columns[ix].m_name);
 	}
 }
 
+void category::delete_row(row *r)
+{
+	if (r != nullptr)
+		m_pool->deallocate(r);
+}
+
 row_handle category::create_copy(row_handle r)
 {
 	// copy the values
@@ -1587,7 +2353,7 @@ row_handle category::create_copy(row_handle r)
 // proxy methods for every insertion
 category::iterator category::insert_impl(const_iterator pos, row *n)
 {
-	if (m_index == nullptr and m_cat_validator != nullptr)
+	if (m_index == nullptr and m_cat_validator != nullptr and not m_deferred_index)
 		m_index = new category_index(this);
 
 	assert(n != nullptr);
@@ -1596,6 +2362,8 @@ category::iterator category::insert_impl(const_iterator pos, row *n)
 	if (n == nullptr)
 		throw std::runtime_error("Invalid pointer passed to insert");
 
+	discard_column_store();
+
 // #ifndef NDEBUG
 // 	if (m_validator)
 // 		is_valid();
@@ -1608,7 +2376,8 @@ category::iterator category::insert_impl(const_iterator pos, row *n)
 		{
 			for (uint16_t ix = 0; ix < static_cast<uint16_t>(m_columns.size()); ++ix)
 			{
-				const auto &[column, iv] = m_columns[ix];
+				const auto &column = m_columns[ix].m_name;
+				auto iv = m_columns[ix].m_validator;
 
 				if (iv == nullptr)
 					continue;
@@ -1630,18 +2399,36 @@ category::iterator category::insert_impl(const_iterator pos, row *n)
 		if (m_index != nullptr)
 			m_index->insert(n);
 
+		// secondary indices are updated when a bulk insert is committed
+		if (not m_deferred_index)
+		{
+			for (auto ix : m_secondary_indices)
+				ix->insert(n);
+		}
+
+		++m_size;
+
 		// insert at end, most often this is the case
 		if (pos.m_current == nullptr)
 		{
 			if (m_head == nullptr)
+			{
 				m_tail = m_head = n;
+				n->m_ordinal = 0;
+				m_ordinals_valid = true;
+			}
 			else
+			{
+				n->m_ordinal = m_tail->m_ordinal + 1;
 				m_tail = m_tail->m_next = n;
+			}
 		}
 		else
 		{
 			assert(m_head != nullptr);
 
+			m_ordinals_valid = false;
+
 			if (pos.m_current == m_head)
 				m_head = n->m_next = m_head;
 			else
@@ -1670,7 +2457,30 @@ void category::swap_item(uint16_t column_ix, row_handle &a, row_handle &b)
 	auto &ra = *a.m_row;
 	auto &rb = *b.m_row;
 
-	std::swap(ra.at(column_ix), rb.at(column_ix));
+	std::vector<std::tuple<secondary_index *, row *>> indices;
+	for (auto ix : m_secondary_indices)
+	{
+		if (not ix->covers(column_ix))
+			continue;
+
+		for (auto r : { &ra, &rb })
+		{
+			if (ix->erase(r))
+				indices.emplace_back(ix, r);
+		}
+	}
+
+	if (column_ix >= ra.size())
+		ra.resize(column_ix + 1, get_arena());
+	if (column_ix >= rb.size())
+		rb.resize(column_ix + 1, get_arena());
+
+	ra.swap_item(column_ix, rb);
+
+	for (auto [ix, r] : indices)
+		ix->insert(r);
+
+	discard_column_store();
 }
 
 void category::sort(std::function<int(row_handle,row_handle)> f)
@@ -1682,6 +2492,8 @@ void category::sort(std::function<int(row_handle,row_handle)> f)
 	for (auto itemRow = m_head; itemRow != nullptr; itemRow = itemRow->m_next)
 		rows.emplace_back(*this, *itemRow);
 
+	discard_column_store();
+
 	std::stable_sort(rows.begin(), rows.end(),
 		[&f](row_handle ia, row_handle ib)
 		{
@@ -1690,6 +2502,7 @@ void category::sort(std::function<int(row_handle,row_handle)> f)
 
 	m_head = rows.front().get_row();
 	m_tail = rows.back().get_row();
+	m_ordinals_valid = false;
 
 	auto r = m_head;
 	for (size_t i = 1; i < rows.size(); ++i)
@@ -1704,6 +2517,524 @@ void category::reorder_by_index()
 {
 	if (m_index)
 		std::tie(m_head, m_tail) = m_index->reorder();
+
+	m_ordinals_valid = false;
+
+	discard_column_store();
+}
+
+// --------------------------------------------------------------------
+
+category::bulk_inserter::bulk_inserter(category &cat)
+	: m_category(cat)
+	, m_last(cat.m_tail)
+	, m_uncaught_exceptions(std::uncaught_exceptions())
+{
+	if (cat.m_deferred_index)
+		throw std::logic_error("There is already a bulk_inserter active for category " + cat.m_name);
+
+	cat.m_deferred_index = true;
+	cat.m_saved_index = std::exchange(cat.m_index, nullptr);
+}
+
+category::bulk_inserter::~bulk_inserter()
+{
+	// Not committing is only allowed when an exception is being thrown
+	assert(m_committed or std::uncaught_exceptions() > m_uncaught_exceptions);
+
+	if (not m_committed)
+	{
+		try
+		{
+			commit();
+		}
+		catch (const std::exception &ex)
+		{
+			std::cerr << "Error committing bulk insert in category " << m_category.m_name << ": " << ex.what() << std::endl;
+		}
+	}
+}
+
+void category::bulk_inserter::commit()
+{
+	if (not std::exchange(m_committed, true))
+		m_category.commit_bulk_insert(m_last);
+}
+
+void category::discard_saved_index()
+{
+	delete m_saved_index;
+	m_saved_index = nullptr;
+}
+
+void category::discard_column_store()
+{
+	// This is called for every modification of the category
+	++m_generation;
+
+	delete m_column_store;
+	m_column_store = nullptr;
+}
+
+const column_store &category::get_column_store() const
+{
+	std::lock_guard lock(m_cache_mutex);
+
+	if (m_column_store == nullptr)
+		m_column_store = new column_store(*this);
+	return *m_column_store;
+}
+
+// --------------------------------------------------------------------
+
+void category::create_index(const std::vector<std::string> &columns)
+{
+	if (columns.empty())
+		throw std::invalid_argument("An index needs at least one column");
+
+	if (has_index(columns))
+		return;
+
+	std::vector<uint16_t> ix;
+	for (auto &column : columns)
+		ix.push_back(add_column(column));
+
+	m_secondary_indices.push_back(new secondary_index(*this, ix));
+}
+
+bool category::has_index(const std::vector<std::string> &columns) const
+{
+	std::vector<uint16_t> ix;
+	for (auto &column : columns)
+		ix.push_back(get_column_ix(column));
+
+	return std::find_if(m_secondary_indices.begin(), m_secondary_indices.end(),
+			   [&ix](secondary_index *si) { return si->get_columns() == ix; }) != m_secondary_indices.end();
+}
+
+void category::drop_index(const std::vector<std::string> &columns)
+{
+	std::vector<uint16_t> ix;
+	for (auto &column : columns)
+		ix.push_back(get_column_ix(column));
+
+	auto i = std::find_if(m_secondary_indices.begin(), m_secondary_indices.end(),
+		[&ix](secondary_index *si) { return si->get_columns() == ix; });
+
+	if (i != m_secondary_indices.end())
+	{
+		delete *i;
+		m_secondary_indices.erase(i);
+	}
+}
+
+void category::create_link_indices()
+{
+	if (m_validator == nullptr or m_cat_validator == nullptr)
+		return;
+
+	for (auto link : m_validator->get_links_for_child(m_name))
+		create_index(link->m_child_keys);
+
+	for (auto link : m_validator->get_links_for_parent(m_name))
+	{
+		if (link->m_parent_keys.size() == 1 and m_cat_validator->m_keys.size() == 1 and
+			iequals(link->m_parent_keys.front(), m_cat_validator->m_keys.front()))
+			continue;
+
+		create_index(link->m_parent_keys);
+	}
+}
+
+std::optional<row *> category::find_by_key_terms(const detail::index_terms &terms) const
+{
+	if (m_index == nullptr or m_cat_validator == nullptr or m_cat_validator->m_keys.empty())
+		return {};
+
+	row_initializer key;
+
+	for (auto &key_name : m_cat_validator->m_keys)
+	{
+		auto t = std::find_if(terms.m_equals.begin(), terms.m_equals.end(),
+			[column = get_column_ix(key_name)](auto &t)
+			{ return std::get<0>(t) == column and not std::get<1>(t).empty() and not std::get<2>(t); });
+
+		if (t == terms.m_equals.end())
+			return {};
+
+		key.emplace_back(key_name, std::get<1>(*t));
+	}
+
+	return m_index->find_by_value(std::move(key));
+}
+
+// --------------------------------------------------------------------
+
+size_t category::scan_parallel(const condition &cond, std::size_t thread_count, std::vector<row *> *rows, bool any) const
+{
+	using detail::condition_program;
+
+	// The first row of each chunk is found walking the list once
+	std::vector<row *> chunks;
+	size_t n = 0;
+	for (auto r = m_head; r != nullptr; r = r->m_next, ++n)
+	{
+		if (n % kParallelChunkSize == 0)
+			chunks.push_back(r);
+	}
+
+	std::vector<size_t> counts(chunks.size(), 0);
+	std::vector<std::vector<row *>> matches(rows != nullptr ? chunks.size() : 0);
+
+	// set when a match is found with any, or when a test failed
+	std::atomic<bool> stop = false;
+
+	auto program = cond.program();
+
+	parallel_for(chunks.size(), [&](std::size_t chunk)
+		{
+		const row *batch[condition_program::kBatchSize];
+		condition_program::selection sel;
+
+		const row *r = chunks[chunk];
+		size_t left = kParallelChunkSize;
+
+		try
+		{
+			while (r != nullptr and left > 0 and not stop)
+			{
+				size_t m = 0;
+				for (; r != nullptr and m < condition_program::kBatchSize and left > 0; r = r->m_next, --left)
+					batch[m++] = r;
+
+				if (program != nullptr)
+					program->evaluate(batch, m, sel);
+				else
+				{
+					sel.fill(0);
+					for (size_t i = 0; i < m; ++i)
+					{
+						if (cond({ *this, *batch[i] }))
+							sel[i / 64] |= uint64_t(1) << (i % 64);
+					}
+				}
+
+				for (size_t i = 0; i < m; ++i)
+				{
+					if ((sel[i / 64] & (uint64_t(1) << (i % 64))) == 0)
+						continue;
+
+					++counts[chunk];
+					if (rows != nullptr)
+						matches[chunk].push_back(const_cast<row *>(batch[i]));
+				}
+
+				if (any and counts[chunk] > 0)
+					stop = true;
+			}
+		}
+		catch (...)
+		{
+			stop = true;
+			throw;
+		} },
+		thread_count);
+
+	if (rows != nullptr)
+	{
+		rows->clear();
+		rows->reserve(std::accumulate(counts.begin(), counts.end(), size_t{ 0 }));
+		for (auto &m : matches)
+			rows->insert(rows->end(), m.begin(), m.end());
+	}
+
+	return std::accumulate(counts.begin(), counts.end(), size_t{ 0 });
+}
+
+void category::prepare_parallel(condition &cond, std::size_t thread_count) const
+{
+	cond.prepare(*this);
+
+	// Rows found using the key or an index are tested in order
+	if (cond.empty() or cond.single().has_value() or cond.candidates() != nullptr or m_size < 2 * kParallelChunkSize)
+		return;
+
+	std::vector<row *> rows;
+	scan_parallel(cond, thread_count, &rows, false);
+
+	cond.m_candidates = std::move(rows);
+	cond.m_candidates_tested = true;
+	cond.m_plan = "PARALLEL SCAN " + m_name;
+}
+
+bool category::exists(const execution::parallel_policy &policy, condition &&cond) const
+{
+	bool result = false;
+
+	if (cond)
+	{
+		cond.prepare(*this);
+
+		if (cond.single().has_value() or cond.candidates() != nullptr or m_size < 2 * kParallelChunkSize)
+			result = exists(std::move(cond));
+		else
+			result = scan_parallel(cond, policy.m_thread_count, nullptr, true) > 0;
+	}
+
+	return result;
+}
+
+size_t category::count(const execution::parallel_policy &policy, condition &&cond) const
+{
+	size_t result = 0;
+
+	if (cond)
+	{
+		cond.prepare(*this);
+
+		if (cond.single().has_value() or cond.candidates() != nullptr or m_size < 2 * kParallelChunkSize)
+			result = count(std::move(cond));
+		else
+			result = scan_parallel(cond, policy.m_thread_count, nullptr, false);
+	}
+
+	return result;
+}
+
+size_t category::erase(const execution::parallel_policy &policy, condition &&cond, std::function<void(row_handle)> &&visit)
+{
+	// erasing a row can cascade to other rows of this category if it links
+	// to itself, the rows found beforehand may then no longer exist
+	bool self_linked = std::find_if(m_child_links.begin(), m_child_links.end(),
+						   [this](const link &l) { return l.linked == this; }) != m_child_links.end();
+
+	if (not self_linked)
+		prepare_parallel(cond, policy.m_thread_count);
+
+	return erase(std::move(cond), std::move(visit));
+}
+
+std::optional<std::vector<row *>> category::find_candidates(const std::vector<detail::index_terms> &alternatives, std::string &plan) const
+{
+	std::vector<row *> result;
+	std::vector<std::tuple<const detail::index_terms *, secondary_index *>> lookups;
+	double estimate = 0;
+
+	std::ostringstream os;
+
+	for (auto &terms : alternatives)
+	{
+		if (&terms != &alternatives.front())
+			os << " OR ";
+
+		// The key index returns at most one row
+		if (auto r = find_by_key_terms(terms); r.has_value())
+		{
+			if (*r != nullptr)
+				result.push_back(*r);
+			estimate += 1;
+			os << "KEY " << m_name;
+			continue;
+		}
+
+		secondary_index *best = nullptr;
+		double best_selectivity = 1;
+
+		for (auto ix : m_secondary_indices)
+		{
+			if (ix->usable(terms) == 0)
+				continue;
+
+			auto selectivity = ix->selectivity(*this, terms);
+			if (best == nullptr or selectivity < best_selectivity)
+			{
+				best = ix;
+				best_selectivity = selectivity;
+			}
+		}
+
+		if (best == nullptr)
+			return {};
+
+		lookups.emplace_back(&terms, best);
+		estimate += best_selectivity * m_size;
+
+		os << "INDEX " << m_name << '(';
+		for (bool first = true; auto column : best->get_columns())
+		{
+			os << (std::exchange(first, false) ? "" : ", ") << m_columns[column].m_name;
+		}
+		os << ')';
+	}
+
+	// Collecting and sorting the rows found is more expensive than testing
+	// a row, an index that finds half of the rows or more is not used.
+	if (estimate > 1 and estimate >= m_size / 2.0)
+		return {};
+
+	for (auto [terms, ix] : lookups)
+		ix->find(*terms, result);
+
+	update_ordinals();
+
+	std::sort(result.begin(), result.end(), [](const row *a, const row *b)
+		{ return a->m_ordinal < b->m_ordinal; });
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+
+	plan = os.str();
+
+	return result;
+}
+
+column_statistics category::get_column_statistics(uint16_t column) const
+{
+	std::lock_guard lock(m_cache_mutex);
+
+	if (m_size > 2 * m_statistics_size or 2 * m_size < m_statistics_size)
+	{
+		m_statistics.clear();
+		m_statistics_size = m_size;
+	}
+
+	if (m_statistics.size() <= column)
+		m_statistics.resize(column + 1);
+
+	auto &result = m_statistics[column];
+
+	if (not result.has_value())
+	{
+		// Read the values of about kSampleSize rows, spread over the
+		// category. Finding these still takes a walk over all rows, the
+		// result is kept until the size of the category changes considerably.
+		const size_t kSampleSize = 1024;
+		const size_t step = std::max<size_t>(1, m_size / kSampleSize);
+
+		std::unordered_map<std::string_view, size_t> counts;
+		size_t sampled = 0, empty = 0, n = 0;
+
+		for (auto r = m_head; r != nullptr; r = r->m_next, ++n)
+		{
+			if (n % step != 0)
+				continue;
+
+			++sampled;
+
+			row_handle rh(*this, *r);
+			auto v = rh[column];
+			if (v.empty())
+				++empty;
+			else
+				++counts[v.text()];
+		}
+
+		result = column_statistics{};
+
+		if (sampled > 0)
+		{
+			// Values seen only once in the sample may be unique or occur
+			// many times in the category, scale them by the square root
+			// of the sampling ratio.
+			auto once = std::count_if(counts.begin(), counts.end(), [](auto &c) { return c.second == 1; });
+
+			result->m_distinct = (counts.size() - once) + once * std::sqrt(static_cast<double>(m_size) / sampled);
+			result->m_empty = static_cast<double>(empty) / sampled;
+		}
+	}
+
+	return *result;
+}
+
+void category::update_ordinals() const
+{
+	std::lock_guard lock(m_cache_mutex);
+
+	if (not m_ordinals_valid)
+	{
+		uint32_t ordinal = 0;
+		for (auto r = m_head; r != nullptr; r = r->m_next)
+			r->m_ordinal = ordinal++;
+
+		m_ordinals_valid = true;
+	}
+}
+
+void category::commit_bulk_insert(row *last)
+{
+	m_deferred_index = false;
+
+	discard_column_store();
+
+	auto first = last ? last->m_next : m_head;
+
+	for (auto ix : m_secondary_indices)
+	{
+		for (auto r = first; r != nullptr; r = r->m_next)
+			ix->insert(r);
+	}
+
+	std::unique_ptr<category_index> index(std::exchange(m_saved_index, nullptr));
+
+	if (m_cat_validator == nullptr)
+		return;
+
+	std::vector<row *> duplicates;
+
+	// Adding the new rows to an existing index is cheaper than rebuilding it
+	if (index)
+	{
+		for (auto r = first; r != nullptr; r = r->m_next)
+		{
+			if (not index->try_insert(r))
+				duplicates.push_back(r);
+		}
+
+		m_index = index.release();
+	}
+	else
+		m_index = new category_index(this, duplicates);
+
+	if (duplicates.empty())
+		return;
+
+	std::string msg;
+	for (auto r : duplicates)
+	{
+		if (not msg.empty())
+			msg += '\n';
+		msg += duplicate_key_message(*this, r);
+	}
+
+	// remove the offending rows, they are not in the index
+	std::set<row *> remove(duplicates.begin(), duplicates.end());
+
+	row *prev = nullptr;
+	for (auto r = m_head; r != nullptr;)
+	{
+		auto next = r->m_next;
+
+		if (remove.count(r))
+		{
+			if (prev == nullptr)
+				m_head = next;
+			else
+				prev->m_next = next;
+
+			for (auto ix : m_secondary_indices)
+				ix->erase(r);
+
+			r->m_next = nullptr;
+			delete_row(r);
+			--m_size;
+		}
+		else
+			prev = r;
+
+		r = next;
+	}
+
+	m_tail = prev;
+
+	throw duplicate_key_error(msg);
 }
 
 namespace detail
@@ -0,0 +1,120 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cif++/column_store.hpp"
+
+namespace cif
+{
+
+// --------------------------------------------------------------------
+
+column_store::column_store(const category &cat)
+	: m_size(cat.size())
+{
+	// Without a dictionary, every column might be numeric until
+	// a value is found that is not a number
+	std::vector<bool> guessed;
+
+	for (auto &col : cat.m_columns)
+	{
+		column c{ col.m_name };
+
+		if (col.m_validator != nullptr)
+			c.m_numeric = col.m_validator->m_type != nullptr and col.m_validator->m_type->m_primitive_type == DDL_PrimitiveType::Numb;
+		else
+			c.m_numeric = cat.m_cat_validator == nullptr;
+
+		guessed.push_back(col.m_validator == nullptr);
+
+		c.m_text.m_offsets.reserve(m_size + 1);
+		if (c.m_numeric)
+			c.m_numbers.reserve(m_size);
+
+		m_columns.emplace_back(std::move(c));
+	}
+
+	for (auto r = cat.m_head; r != nullptr; r = r->m_next)
+	{
+		for (uint16_t ix = 0; ix < m_columns.size(); ++ix)
+		{
+			auto &c = m_columns[ix];
+
+			std::string_view text;
+			if (auto iv = r->get(ix); iv != nullptr)
+				text = iv->text();
+
+			c.m_text.m_text.append(text);
+			c.m_text.m_offsets.push_back(c.m_text.m_text.length());
+
+			if (not c.m_numeric)
+				continue;
+
+			double v = std::numeric_limits<double>::quiet_NaN();
+
+			if (not(text.empty() or text == "." or text == "?"))
+			{
+				auto rc = selected_charconv<double>::from_chars(text.data(), text.data() + text.length(), v);
+				// a standard uncertainty in parentheses may follow the number
+				if (rc.ec != std::errc() or (rc.ptr != text.data() + text.length() and *rc.ptr != '('))
+				{
+					v = std::numeric_limits<double>::quiet_NaN();
+
+					if (guessed[ix])
+					{
+						c.m_numeric = false;
+						c.m_numbers.clear();
+						continue;
+					}
+				}
+			}
+
+			c.m_numbers.push_back(v);
+		}
+	}
+}
+
+std::size_t column_store::get_column_ix(std::string_view column_name) const
+{
+	for (std::size_t ix = 0; ix < m_columns.size(); ++ix)
+	{
+		if (iequals(m_columns[ix].m_name, column_name))
+			return ix;
+	}
+
+	throw std::out_of_range("column " + std::string{ column_name } + " is not part of this column store");
+}
+
+std::span<const double> column_store::numbers(std::string_view column_name) const
+{
+	auto &c = m_columns[get_column_ix(column_name)];
+
+	if (not c.m_numeric)
+		throw std::invalid_argument("column " + c.m_name + " is not numeric");
+
+	return c.m_numbers;
+}
+
+} // namespace cif
@@ -26,12 +26,18 @@
 
 #include "cif++.hpp"
 
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <map>
 #include <mutex>
 #include <numeric>
 #include <shared_mutex>
+#include <system_error>
+
+#if _MSC_VER
+#include <process.h>
+#endif
 
 namespace fs = std::filesystem;
 
@@ -459,6 +465,199 @@ compound_factory_impl::compound_factory_impl(const fs::path &file, std::shared_p
 	}
 }
 
+// --------------------------------------------------------------------
+// Creating the index for components.cif takes a while, so we store it in
+// a sidecar file next to it. The index file records the path, size and
+// modification time of the components file as well as a hash of its first
+// and last parts. If any of these differ, the index is rebuilt.
+
+namespace
+{
+
+const char kCCDIndexMagic[8] = { 'C', 'I', 'F', 'I', 'D', 'X', '0', '1' };
+
+struct ccd_index_header
+{
+	char magic[8];
+	uint64_t size;
+	int64_t mtime;
+	uint64_t hash;
+	uint32_t path_length;
+	uint32_t entry_count;
+};
+
+struct ccd_source_info
+{
+	std::string path;
+	uint64_t size;
+	int64_t mtime;
+	uint64_t hash;
+};
+
+bool get_source_info(const fs::path &file, ccd_source_info &info)
+{
+	std::error_code ec;
+
+	info.path = fs::weakly_canonical(file, ec).string();
+	if (ec)
+		return false;
+
+	info.size = fs::file_size(file, ec);
+	if (ec)
+		return false;
+
+	info.mtime = fs::last_write_time(file, ec).time_since_epoch().count();
+	if (ec)
+		return false;
+
+	// FNV-1a over the first and last 64 KiB
+	const std::size_t kBlockSize = 64 * 1024;
+
+	std::ifstream in(file, std::ios::binary);
+	if (not in.is_open())
+		return false;
+
+	std::vector<char> buffer(kBlockSize);
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (uint64_t offset : { uint64_t(0), info.size > kBlockSize ? info.size - kBlockSize : uint64_t(0) })
+	{
+		in.seekg(offset);
+		in.read(buffer.data(), buffer.size());
+
+		for (std::streamsize i = 0; i < in.gcount(); ++i)
+			hash = (hash ^ static_cast<uint8_t>(buffer[i])) * 1099511628211ULL;
+
+		in.clear();
+	}
+
+	info.hash = hash;
+	return true;
+}
+
+fs::path get_index_path(const fs::path &file)
+{
+	return file.string() + ".idx";
+}
+
+cif::parser::datablock_index read_ccd_index(const fs::path &file)
+{
+	cif::parser::datablock_index result;
+
+	ccd_source_info info;
+	if (not get_source_info(file, info))
+		return result;
+
+	cif::mapped_file mf(get_index_path(file));
+	if (not mf or mf.size() < sizeof(ccd_index_header))
+		return result;
+
+	const char *p = mf.data(), *e = p + mf.size();
+
+	ccd_index_header h;
+	std::memcpy(&h, p, sizeof(h));
+	p += sizeof(h);
+
+	if (std::memcmp(h.magic, kCCDIndexMagic, sizeof(h.magic)) != 0 or
+		h.size != info.size or h.mtime != info.mtime or h.hash != info.hash or
+		static_cast<std::size_t>(e - p) < h.path_length or
+		std::string_view(p, h.path_length) != info.path)
+	{
+		return result;
+	}
+
+	p += h.path_length;
+
+	for (uint32_t i = 0; i < h.entry_count; ++i)
+	{
+		uint64_t offset;
+		uint32_t name_length;
+
+		if (static_cast<std::size_t>(e - p) < sizeof(offset) + sizeof(name_length))
+			break;
+
+		std::memcpy(&offset, p, sizeof(offset));
+		p += sizeof(offset);
+		std::memcpy(&name_length, p, sizeof(name_length));
+		p += sizeof(name_length);
+
+		if (static_cast<std::size_t>(e - p) < name_length)
+			break;
+
+		result.emplace_hint(result.end(), std::string(p, name_length), offset);
+		p += name_length;
+	}
+
+	// A truncated file is not to be trusted
+	if (result.size() != h.entry_count)
+		result.clear();
+
+	return result;
+}
+
+void write_ccd_index(const fs::path &file, const cif::parser::datablock_index &index)
+{
+	ccd_source_info info;
+	if (not get_source_info(file, info))
+		throw std::runtime_error("Could not read components file " + file.string());
+
+	ccd_index_header h{};
+	std::memcpy(h.magic, kCCDIndexMagic, sizeof(h.magic));
+	h.size = info.size;
+	h.mtime = info.mtime;
+	h.hash = info.hash;
+	h.path_length = static_cast<uint32_t>(info.path.length());
+	h.entry_count = static_cast<uint32_t>(index.size());
+
+	// Write to a temporary file first, other processes might be reading the index
+	auto indexFile = get_index_path(file);
+	auto tmpFile = indexFile;
+#if _MSC_VER
+	tmpFile += "." + std::to_string(_getpid()) + ".tmp";
+#else
+	tmpFile += "." + std::to_string(getpid()) + ".tmp";
+#endif
+
+	std::error_code ec;
+
+	{
+		std::ofstream out(tmpFile, std::ios::binary);
+		if (not out.is_open())
+			throw std::runtime_error("Could not create components index file " + tmpFile.string());
+
+		out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+		out.write(info.path.data(), info.path.length());
+
+		for (auto &[name, offset] : index)
+		{
+			uint64_t o = offset;
+			uint32_t l = static_cast<uint32_t>(name.length());
+
+			out.write(reinterpret_cast<const char *>(&o), sizeof(o));
+			out.write(reinterpret_cast<const char *>(&l), sizeof(l));
+			out.write(name.data(), name.length());
+		}
+
+		out.close();
+
+		if (out.fail())
+		{
+			fs::remove(tmpFile, ec);
+			throw std::runtime_error("Error writing components index file " + tmpFile.string());
+		}
+	}
+
+	fs::rename(tmpFile, indexFile, ec);
+	if (ec)
+	{
+		std::error_code ec2;
+		fs::remove(tmpFile, ec2);
+		throw std::system_error(ec, "Could not write components index file " + indexFile.string());
+	}
+}
+
+} // namespace
+
 // --------------------------------------------------------------------
 // Version for the default compounds, based on the cached components.cif file from CCD
 
@@ -502,6 +701,12 @@ compound *CCD_compound_factory_impl::create(const std::string &id)
 
 	cif::file file;
 
+	// The index can only be stored if components.cif is a file on disk
+	fs::path indexedFile = mCompoundsFile.empty() ? cif::locate_resource("components.cif") : mCompoundsFile;
+
+	if (mIndex.empty() and not indexedFile.empty())
+		mIndex = read_ccd_index(indexedFile);
+
 	if (mIndex.empty())
 	{
 		if (cif::VERBOSE > 1)
@@ -517,6 +722,21 @@ compound *CCD_compound_factory_impl::create(const std::string &id)
 		if (cif::VERBOSE > 1)
 			std::cout << " done" << std::endl;
 
+		// Not being able to store the index is not fatal, it only costs time
+		if (not indexedFile.empty())
+		{
+			try
+			{
+				write_ccd_index(indexedFile, mIndex);
+			}
+			catch (const std::exception &ex)
+			{
+				if (cif::VERBOSE >= 0)
+					std::cerr << "When trying to store the index for the components file " << indexedFile << " there was an exception:" << std::endl
+							  << ex.what() << std::endl;
+			}
+		}
+
 		// reload the resource, perhaps this should be improved...
 		if (mCompoundsFile.empty())
 		{
@@ -27,6 +27,10 @@
 #include "cif++/category.hpp"
 #include "cif++/condition.hpp"
 
+#include <bit>
+#include <cstring>
+#include <iomanip>
+
 namespace cif
 {
 
@@ -40,6 +44,11 @@ uint16_t get_column_ix(const category &cat, std::string_view col)
 	return cat.get_column_ix(col);
 }
 
+column_statistics get_column_statistics(const category &cat, uint16_t column)
+{
+	return cat.get_column_statistics(column);
+}
+
 bool is_column_type_uchar(const category &cat, std::string_view col)
 {
 	bool result = false;
@@ -61,19 +70,62 @@ bool is_column_type_uchar(const category &cat, std::string_view col)
 namespace detail
 {
 
+	const bound_value &parameter_value(const std::vector<bound_value> &values, size_t index)
+	{
+		if (index >= values.size())
+			throw std::out_of_range("No value bound to parameter $" + std::to_string(index));
+		return values[index];
+	}
+
+	// --------------------------------------------------------------------
+
 	condition_impl *key_equals_condition_impl::prepare(const category &c)
 	{
 		m_item_ix = c.get_column_ix(m_item_tag);
 		m_icase = is_column_type_uchar(c, m_item_tag);
 
+		lookup(c);
+
+		m_selectivity = get_column_statistics(c, m_item_ix).equal_fraction();
+
+		return this;
+	}
+
+	void key_equals_condition_impl::bind(const category &c, const std::vector<bound_value> &values)
+	{
+		if (m_parameter.has_value())
+		{
+			m_value = parameter_value(values, *m_parameter).m_text;
+			m_null = m_value.empty();
+			lookup(c);
+		}
+	}
+
+	void key_equals_condition_impl::lookup(const category &c)
+	{
+		m_single_hit.reset();
+		m_interned_matches.clear();
+
+		if (m_null)
+			return;
+
 		if (c.get_cat_validator() != nullptr and
 			c.key_field_indices().contains(m_item_ix) and
 			c.key_field_indices().size() == 1)
 		{
 			m_single_hit = c[{ { m_item_tag, m_value } }];
 		}
-
-		return this;
+		else if (auto table = c.get_string_table(m_item_ix); table != nullptr)
+		{
+			// Interned columns have only a few distinct values, check them
+			// all once
+			m_interned_matches.resize(table->size());
+			for (uint32_t id = 0; id < table->size(); ++id)
+			{
+				auto text = (*table)[id];
+				m_interned_matches[id] = (m_icase ? icompare(text, m_value) : text.compare(m_value)) == 0;
+			}
+		}
 	}
 
 	bool found_in_range(condition_impl *c, std::vector<and_condition_impl *>::iterator b, std::vector<and_condition_impl *>::iterator e)
@@ -148,20 +200,526 @@ namespace detail
 				and_conditions.push_back(static_cast<and_condition_impl *>(sub));
 		}
 
+		// Test the cheapest sub conditions that are most likely to match first
+		and_condition_impl::order_subs(m_sub, [](double cost, double selectivity)
+			{ return selectivity > 0 ? cost / selectivity : std::numeric_limits<double>::infinity(); });
+
 		if (and_conditions.size() == m_sub.size())
 			return and_condition_impl::combine_equal(and_conditions, this);
 
 		return this;
 	}
 
+	// --------------------------------------------------------------------
+
+	namespace
+	{
+		using selection = condition_program::selection;
+		constexpr size_t kBatchSize = condition_program::kBatchSize;
+
+		bool any(const selection &sel)
+		{
+			for (auto w : sel)
+			{
+				if (w != 0)
+					return true;
+			}
+			return false;
+		}
+
+		// Return the index of the first bit set in \a sel at or after \a i, or \a n
+		size_t next_bit(const selection &sel, size_t i, size_t n)
+		{
+			while (i < n)
+			{
+				auto w = sel[i / 64] >> (i % 64);
+				if (w != 0)
+					return std::min(i + std::countr_zero(w), n);
+				i = (i / 64 + 1) * 64;
+			}
+			return n;
+		}
+
+		template <typename F>
+		void for_each_bit(const selection &sel, F &&f)
+		{
+			for (size_t w = 0; w < sel.size(); ++w)
+			{
+				for (auto bits = sel[w]; bits != 0; bits &= bits - 1)
+					f(w * 64 + std::countr_zero(bits));
+			}
+		}
+
+		// Clear the bits in \a sel for which \a match is zero
+		void pack(const uint8_t match[kBatchSize], selection &sel)
+		{
+			for (size_t w = 0; w < sel.size(); ++w)
+			{
+				uint64_t bits = 0;
+				for (size_t b = 0; b < 64; ++b)
+					bits |= uint64_t(match[w * 64 + b] != 0) << b;
+				sel[w] &= bits;
+			}
+		}
+	} // namespace
+
+	condition_program::condition_program(const category &cat, const condition_impl *impl)
+		: m_category(cat)
+		, m_batch(kBatchSize)
+	{
+		compile(impl);
+	}
+
+	void condition_program::compile(const condition_impl *impl)
+	{
+		using kind = instruction::kind;
+
+		size_t ix = m_code.size();
+		m_code.push_back({ kind::test });
+		m_code[ix].m_impl = impl;
+
+		std::vector<const condition_impl *> operands;
+		auto &ins = m_code[ix];
+
+		if (typeid(*impl) == typeid(all_condition_impl))
+			ins.m_kind = kind::all;
+		else if (typeid(*impl) == typeid(key_equals_condition_impl))
+		{
+			auto c = static_cast<const key_equals_condition_impl *>(impl);
+			if (not c->m_single_hit.has_value())
+			{
+				ins.m_kind = c->m_null ? kind::empty : kind::equals;
+				ins.m_column = c->m_item_ix;
+				ins.m_icase = c->m_icase;
+				ins.m_value = c->m_value;
+				if (not c->m_interned_matches.empty())
+					ins.m_interned = &c->m_interned_matches;
+			}
+		}
+		else if (typeid(*impl) == typeid(key_equals_or_empty_condition_impl))
+		{
+			auto c = static_cast<const key_equals_or_empty_condition_impl *>(impl);
+			if (not c->m_single_hit.has_value())
+			{
+				ins.m_kind = kind::equals_or_empty;
+				ins.m_column = c->m_item_ix;
+				ins.m_icase = c->m_icase;
+				ins.m_value = c->m_value;
+			}
+		}
+		else if (typeid(*impl) == typeid(key_is_empty_condition_impl))
+		{
+			ins.m_kind = kind::empty;
+			ins.m_column = static_cast<const key_is_empty_condition_impl *>(impl)->m_item_ix;
+		}
+		else if (typeid(*impl) == typeid(key_is_not_empty_condition_impl))
+		{
+			ins.m_kind = kind::not_empty;
+			ins.m_column = static_cast<const key_is_not_empty_condition_impl *>(impl)->m_item_ix;
+		}
+		else if (typeid(*impl) == typeid(key_compare_condition_impl))
+		{
+			auto c = static_cast<const key_compare_condition_impl *>(impl);
+			if (c->m_number.has_value() and not c->m_text.has_value())
+			{
+				ins.m_kind = kind::number;
+				ins.m_column = c->m_item_ix;
+				ins.m_number = *c->m_number;
+			}
+		}
+		else if (typeid(*impl) == typeid(and_condition_impl))
+		{
+			ins.m_kind = kind::op_and;
+			auto &sub = static_cast<const and_condition_impl *>(impl)->m_sub;
+			operands.assign(sub.begin(), sub.end());
+		}
+		else if (typeid(*impl) == typeid(or_condition_impl))
+		{
+			ins.m_kind = kind::op_or;
+			auto &sub = static_cast<const or_condition_impl *>(impl)->m_sub;
+			operands.assign(sub.begin(), sub.end());
+		}
+		else if (typeid(*impl) == typeid(not_condition_impl))
+		{
+			ins.m_kind = kind::op_not;
+			operands.push_back(static_cast<const not_condition_impl *>(impl)->mA);
+		}
+
+		// operands follow their operator
+		for (auto operand : operands)
+			compile(operand);
+
+		m_code[ix].m_end = m_code.size();
+	}
+
+	size_t condition_program::fill(const row *r, const row *rows[kBatchSize])
+	{
+		size_t n = 0;
+		for (; r != nullptr and n < kBatchSize; r = r->m_next)
+			rows[n++] = r;
+		return n;
+	}
+
+	void condition_program::evaluate(const row *const rows[], size_t n, selection &sel) const
+	{
+		sel.fill(0);
+		for (size_t w = 0; w * 64 < n; ++w)
+			sel[w] = n - w * 64 >= 64 ? ~uint64_t(0) : (uint64_t(1) << (n - w * 64)) - 1;
+
+		evaluate(0, rows, n, sel);
+	}
+
+	void condition_program::evaluate(size_t ix, const row *const rows[], size_t n, selection &sel) const
+	{
+		using kind = instruction::kind;
+
+		auto &ins = m_code[ix];
+
+		// Values of the column in the rows of the batch, only gathered for
+		// the rows that are selected
+		auto gather_text = [&](std::string_view text[kBatchSize])
+		{
+			for_each_bit(sel, [&](size_t i)
+				{
+				auto iv = rows[i]->get(ins.m_column);
+				text[i] = iv != nullptr ? iv->text() : std::string_view{}; });
+		};
+
+		uint8_t match[kBatchSize] = {};
+
+		switch (ins.m_kind)
+		{
+			case kind::all:
+				break;
+
+			case kind::test:
+				for_each_bit(sel, [&](size_t i)
+					{
+					if (not ins.m_impl->test({ m_category, *rows[i] }))
+						sel[i / 64] &= ~(uint64_t(1) << (i % 64)); });
+				break;
+
+			case kind::equals:
+			case kind::equals_or_empty:
+			{
+				std::string_view text[kBatchSize];
+				gather_text(text);
+
+				// Compare lengths first, in a loop the compiler can vectorize,
+				// then the text for the values of the right length
+				const size_t length = ins.m_value.length();
+				uint8_t same_length[kBatchSize] = {};
+				for (size_t i = 0; i < n; ++i)
+					same_length[i] = text[i].length() == length;
+
+				// Interned values are compared by id, values added later by text
+				if (ins.m_interned != nullptr)
+				{
+					for_each_bit(sel, [&](size_t i)
+						{
+						auto iv = rows[i]->get(ins.m_column);
+						auto id = iv != nullptr ? iv->interned_id() : string_table::npos;
+						if (id < ins.m_interned->size())
+						{
+							match[i] = (*ins.m_interned)[id];
+							same_length[i] = false;
+						} });
+				}
+
+				for (size_t i = 0; i < n; ++i)
+				{
+					if (same_length[i])
+						match[i] = ins.m_icase ? icompare(text[i], ins.m_value) == 0 : length == 0 or std::memcmp(text[i].data(), ins.m_value.data(), length) == 0;
+				}
+
+				if (ins.m_kind == kind::equals_or_empty)
+				{
+					for (size_t i = 0; i < n; ++i)
+						match[i] |= text[i].empty() or (text[i].length() == 1 and (text[i].front() == '.' or text[i].front() == '?'));
+				}
+
+				pack(match, sel);
+				break;
+			}
+
+			case kind::empty:
+			case kind::not_empty:
+			{
+				std::string_view text[kBatchSize];
+				gather_text(text);
+
+				const bool empty = ins.m_kind == kind::empty;
+				for (size_t i = 0; i < n; ++i)
+				{
+					bool is_empty = text[i].empty() or (text[i].length() == 1 and (text[i].front() == '.' or text[i].front() == '?'));
+					match[i] = is_empty == empty;
+				}
+
+				pack(match, sel);
+				break;
+			}
+
+			case kind::number:
+			{
+				// The numbers are parsed when stored in the rows, just
+				// like item_handle::compare uses them
+				auto &nc = ins.m_number;
+
+				double value[kBatchSize] = {};
+				uint8_t valid[kBatchSize] = {};
+
+				for_each_bit(sel, [&](size_t i)
+					{
+					auto iv = rows[i]->get(ins.m_column);
+					if (iv == nullptr or iv->text().empty())
+						return;
+
+					std::errc ec;
+					if (nc.m_float)
+					{
+						float f = 0;
+						ec = rows[i]->number(ins.m_column, f);
+						value[i] = f;
+					}
+					else
+						ec = rows[i]->number(ins.m_column, value[i]);
+
+					valid[i] = ec == std::errc();
+
+					if (ec != std::errc() and cif::VERBOSE)
+					{
+						if (ec == std::errc::invalid_argument)
+							std::cerr << "Attempt to convert " << std::quoted(iv->text()) << " into a number" << std::endl;
+						else if (ec == std::errc::result_out_of_range)
+							std::cerr << "Conversion of " << std::quoted(iv->text()) << " into a type that is too small" << std::endl;
+					} });
+
+				// values that are not a number compare as larger
+				if (nc.m_float)
+				{
+					const float x = static_cast<float>(nc.m_value);
+					for (size_t i = 0; i < n; ++i)
+					{
+						const float v = static_cast<float>(value[i]);
+						const bool lt = v < x, gt = v > x;
+						match[i] = valid[i] ? ((nc.m_less & lt) | (nc.m_equal & not(lt | gt)) | (nc.m_greater & gt)) : nc.m_greater;
+					}
+				}
+				else
+				{
+					const double x = nc.m_value;
+					for (size_t i = 0; i < n; ++i)
+					{
+						const double v = value[i];
+						const bool lt = v < x, gt = v > x;
+						match[i] = valid[i] ? ((nc.m_less & lt) | (nc.m_equal & not(lt | gt)) | (nc.m_greater & gt)) : nc.m_greater;
+					}
+				}
+
+				pack(match, sel);
+				break;
+			}
+
+			case kind::op_and:
+				for (size_t op = ix + 1; op < ins.m_end and any(sel); op = m_code[op].m_end)
+					evaluate(op, rows, n, sel);
+				break;
+
+			case kind::op_or:
+			{
+				// operands are only evaluated for the rows not matched yet
+				selection remaining = sel;
+				sel.fill(0);
+
+				for (size_t op = ix + 1; op < ins.m_end and any(remaining); op = m_code[op].m_end)
+				{
+					selection s = remaining;
+					evaluate(op, rows, n, s);
+
+					for (size_t w = 0; w < sel.size(); ++w)
+					{
+						sel[w] |= s[w];
+						remaining[w] &= ~s[w];
+					}
+				}
+				break;
+			}
+
+			case kind::op_not:
+			{
+				selection s = sel;
+				evaluate(ix + 1, rows, n, s);
+
+				for (size_t w = 0; w < sel.size(); ++w)
+					sel[w] &= ~s[w];
+				break;
+			}
+		}
+	}
+
+	const row *condition_program::find_next(const row *r) const
+	{
+		if (r == nullptr)
+			return nullptr;
+
+		size_t i = m_batch_next;
+
+		// Continue in the last batch if r is the row following the previous match
+		if (m_batch_size == 0 or m_batch_generation != m_category.m_generation or
+			i >= m_batch_size or m_batch[i] != r)
+		{
+			m_batch_size = fill(r, m_batch.data());
+			m_batch_generation = m_category.m_generation;
+			evaluate(m_batch.data(), m_batch_size, m_batch_selection);
+			i = 0;
+		}
+
+		for (;;)
+		{
+			i = next_bit(m_batch_selection, i, m_batch_size);
+			if (i < m_batch_size)
+			{
+				m_batch_next = i + 1;
+				return m_batch[i];
+			}
+
+			auto next = m_batch[m_batch_size - 1]->m_next;
+			if (next == nullptr)
+			{
+				m_batch_size = 0;
+				return nullptr;
+			}
+
+			m_batch_size = fill(next, m_batch.data());
+			evaluate(m_batch.data(), m_batch_size, m_batch_selection);
+			i = 0;
+		}
+	}
+
+	size_t condition_program::count(const row *r) const
+	{
+		size_t result = 0;
+
+		const row *rows[kBatchSize];
+		selection sel;
+
+		while (r != nullptr)
+		{
+			auto n = fill(r, rows);
+			evaluate(rows, n, sel);
+
+			for (auto w : sel)
+				result += std::popcount(w);
+
+			r = rows[n - 1]->m_next;
+		}
+
+		return result;
+	}
+
+	void condition_program::bind()
+	{
+		using kind = instruction::kind;
+
+		for (auto &ins : m_code)
+		{
+			auto impl = ins.m_impl;
+
+			// the kind of test may depend on the value bound
+			if (typeid(*impl) == typeid(key_equals_condition_impl) and ins.m_kind != kind::test)
+			{
+				auto c = static_cast<const key_equals_condition_impl *>(impl);
+				ins.m_kind = c->m_null ? kind::empty : kind::equals;
+				ins.m_value = c->m_value;
+				ins.m_interned = c->m_interned_matches.empty() ? nullptr : &c->m_interned_matches;
+			}
+			else if (ins.m_kind == kind::equals_or_empty)
+				ins.m_value = static_cast<const key_equals_or_empty_condition_impl *>(impl)->m_value;
+			else if (typeid(*impl) == typeid(key_compare_condition_impl))
+			{
+				auto c = static_cast<const key_compare_condition_impl *>(impl);
+				if (c->m_number.has_value() and not c->m_text.has_value())
+				{
+					ins.m_kind = kind::number;
+					ins.m_column = c->m_item_ix;
+					ins.m_number = *c->m_number;
+				}
+				else
+					ins.m_kind = kind::test;
+			}
+		}
+
+		m_batch_size = 0;
+	}
+
 } // namespace detail
 
 void condition::prepare(const category &c)
 {
+	delete m_program;
+	m_program = nullptr;
+
 	if (m_impl)
+	{
 		m_impl = m_impl->prepare(c);
-	
+		plan(c);
+	}
+	else
+	{
+		m_candidates.reset();
+		m_candidates_tested = false;
+		m_plan.clear();
+	}
+
 	m_prepared = true;
 }
 
+void condition::bind(const category &c, const std::vector<detail::bound_value> &values)
+{
+	assert(m_prepared);
+
+	if (m_impl)
+	{
+		m_impl->bind(c, values);
+		plan(c);
+	}
+}
+
+void condition::plan(const category &c)
+{
+	m_candidates.reset();
+	m_candidates_tested = false;
+	m_plan.clear();
+
+	if (m_impl->single().has_value())
+		m_plan = "KEY " + c.name();
+	else
+	{
+		std::vector<detail::index_terms> alternatives;
+		if (m_impl->collect_index_alternatives(alternatives))
+			m_candidates = c.find_candidates(alternatives, m_plan);
+	}
+
+	if (m_plan.empty())
+		m_plan = "SCAN " + c.name();
+
+	// All rows are tested, evaluate them in batches. The program is kept
+	// when the condition is bound to new values.
+	if (not m_candidates.has_value() and not m_impl->single().has_value() and
+		c.size() >= detail::condition_program::kMinRows)
+	{
+		if (m_program == nullptr)
+			m_program = new detail::condition_program(c, m_impl);
+		else
+			m_program->bind();
+	}
+	else
+	{
+		delete m_program;
+		m_program = nullptr;
+	}
+
+	m_row_count = c.size();
+}
+
 } // namespace cif
@@ -68,6 +68,12 @@ void datablock::set_validator(const validator *v)
 	}
 }
 
+void datablock::create_link_indices()
+{
+	for (auto &cat : *this)
+		cat.create_link_indices();
+}
+
 const validator *datablock::get_validator() const
 {
 	return m_validator;
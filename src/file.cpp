@@ -26,6 +26,11 @@
 
 #include "cif++/file.hpp"
 #include "cif++/gzio.hpp"
+#include "cif++/utilities.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
 
 namespace cif
 {
@@ -87,6 +92,75 @@ bool file::validate_links() const
 	return result;
 }
 
+validation_report file::validate(std::size_t thread_count) const
+{
+	if (m_validator == nullptr)
+		throw std::runtime_error("No validator loaded explicitly, cannot continue");
+
+	// Each category is a task for validating its structure and
+	// the rows of each category are split into chunks for the values
+	const std::size_t kChunkSize = 10000;
+
+	struct task
+	{
+		const datablock *db;
+		const category *cat;
+		category::const_iterator b, e;
+		std::size_t row_nr;
+		bool structure;
+	};
+
+	std::vector<task> tasks;
+
+	for (auto &db : *this)
+	{
+		for (auto &cat : db)
+		{
+			tasks.push_back({ &db, &cat, cat.end(), cat.end(), 0, true });
+
+			if (cat.get_cat_validator() == nullptr)
+				continue;
+
+			auto b = cat.begin();
+			std::size_t first = 0, n = 0;
+
+			for (auto i = cat.begin(); i != cat.end(); ++i, ++n)
+			{
+				if (n - first == kChunkSize)
+				{
+					tasks.push_back({ &db, &cat, b, i, first, false });
+					b = i;
+					first = n;
+				}
+			}
+
+			if (b != cat.end())
+				tasks.push_back({ &db, &cat, b, cat.end(), first, false });
+		}
+	}
+
+	std::vector<validation_report> reports(tasks.size());
+
+	parallel_for(tasks.size(), [&](std::size_t i)
+		{
+			auto &t = tasks[i];
+
+			if (t.structure)
+				t.cat->validate_structure(reports[i]);
+			else
+				t.cat->validate_values(reports[i], t.b, t.e, t.row_nr);
+
+			for (auto &m : reports[i])
+				m.m_datablock = t.db->name();
+		}, thread_count);
+
+	validation_report result;
+	for (auto &r : reports)
+		std::move(r.begin(), r.end(), std::back_inserter(result));
+
+	return result;
+}
+
 void file::load_dictionary()
 {
 	if (not empty())
@@ -180,15 +254,26 @@ std::tuple<file::iterator, bool> file::emplace(std::string_view name)
 	return std::make_tuple(begin(), is_new);
 }
 
-void file::load(const std::filesystem::path &p)
+void file::load(const std::filesystem::path &p, const iset &categories)
 {
 	try
 	{
+		// Uncompressed files are memory mapped and parsed in place
+		if (p.extension() != ".gz")
+		{
+			mapped_file mf(p);
+			if (mf)
+			{
+				load(mf.data(), mf.size(), categories);
+				return;
+			}
+		}
+
 		gzio::ifstream in(p);
 		if (not in.is_open())
 			throw std::runtime_error("Could not open file " + p.string());
 
-		load(in);
+		load(in, categories);
 	}
 	catch (const std::exception &)
 	{
@@ -196,20 +281,152 @@ void file::load(const std::filesystem::path &p)
 	}
 }
 
-void file::load(std::istream &is)
+void file::load(std::istream &is, const iset &categories)
+{
+	parser p(is, *this);
+	load(p, categories);
+}
+
+void file::load(const char *data, std::size_t length, const iset &categories)
+{
+	parser p(data, length, *this);
+	load(p, categories);
+}
+
+void file::load(parser &p, const iset &categories)
 {
 	auto saved = m_validator;
 	set_validator(nullptr);
 
-	parser p(is, *this);
+	p.set_category_filter(categories);
 	p.parse_file();
 
+	loaded(saved);
+}
+
+void file::loaded(const validator *saved)
+{
 	if (saved != nullptr)
 		set_validator(saved);
 	else
 		load_dictionary();
 }
 
+void file::load_parallel(const std::filesystem::path &p, std::size_t thread_count)
+{
+	try
+	{
+		if (p.extension() != ".gz")
+		{
+			mapped_file mf(p);
+			if (mf)
+			{
+				load_parallel_buffer(mf.data(), mf.size(), thread_count);
+				return;
+			}
+		}
+
+		gzio::ifstream in(p);
+		if (not in.is_open())
+			throw std::runtime_error("Could not open file " + p.string());
+
+		std::ostringstream os;
+		os << in.rdbuf();
+		auto data = os.str();
+
+		load_parallel_buffer(data.data(), data.length(), thread_count);
+	}
+	catch (const std::exception &)
+	{
+		throw_with_nested(std::runtime_error("Error reading file " + p.string()));
+	}
+}
+
+void file::load_parallel_buffer(const char *data, std::size_t length, std::size_t thread_count)
+{
+	// Locate the start of each datablock, the index contains the offset
+	// just past the name and the white space following it.
+	std::vector<std::size_t> starts;
+
+	{
+		file dummy;
+		parser p(data, length, dummy);
+
+		for (auto &[name, offset] : p.index_datablocks())
+		{
+			// Only split where data_ starts a token, the index should
+			// only contain those but better safe than sorry.
+			auto start = offset - name.length() - 6;
+			if (offset >= name.length() + 6 and iequals(std::string_view(data + start, 5), "data_") and
+				(start == 0 or sac_parser::is_space(data[start - 1])))
+				starts.push_back(start);
+		}
+	}
+
+	// Each part runs up to the start of the next datablock, the first
+	// part starts at the beginning to include anything preceding the
+	// first datablock, which is not in the index since the parser already
+	// read it as its first token.
+	starts.push_back(0);
+	starts.push_back(length);
+
+	std::sort(starts.begin(), starts.end());
+	starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+	if (starts.size() < 3)
+	{
+		load(data, length);
+		return;
+	}
+
+	std::vector<file> parts(starts.size() - 1);
+
+	try
+	{
+		parallel_for(parts.size(), [&](std::size_t i)
+			{
+				parser p(data + starts[i], starts[i + 1] - starts[i], parts[i]);
+				p.parse_file(); },
+			thread_count);
+	}
+	catch (const std::exception &ex)
+	{
+		// Parse serially, this will report the correct line number
+		if (VERBOSE > 1)
+			std::cerr << "Parallel parsing failed: " << ex.what() << std::endl;
+
+		load(data, length);
+		return;
+	}
+
+	// Datablocks with the same name are merged when parsing serially,
+	// simply do that when this happens.
+	iset names;
+	for (auto &db : *this)
+		names.insert(db.name());
+
+	for (auto &part : parts)
+	{
+		for (auto &db : part)
+		{
+			if (not names.insert(db.name()).second)
+			{
+				load(data, length);
+				return;
+			}
+		}
+	}
+
+	// parse_file puts datablocks in front, so the last part goes in front
+	auto saved = m_validator;
+	set_validator(nullptr);
+
+	for (auto &part : parts)
+		splice(begin(), part);
+
+	loaded(saved);
+}
+
 void file::save(const std::filesystem::path &p) const
 {
 	gzio::ofstream outFile(p);
@@ -32,6 +32,103 @@ namespace cif
 {
 
 const item_handle item_handle::s_null_item;
+
+// --------------------------------------------------------------------
+
+char *string_arena::allocate(size_t length)
+{
+	if (length > kMaxLength)
+		return nullptr;
+
+	size_t size = slot_size(length);
+	auto &free = m_free[size / kGranularity];
+
+	char *result;
+
+	if (free != nullptr)
+	{
+		result = free;
+		std::memcpy(&free, result, sizeof(char *));
+	}
+	else
+	{
+		if (m_used + size > kBlockSize)
+		{
+			m_blocks.emplace_back(new char[kBlockSize]);
+			m_used = 0;
+		}
+
+		result = m_blocks.back().get() + m_used;
+		m_used += size;
+	}
+
+	return result;
+}
+
+void string_arena::deallocate(char *p, size_t length)
+{
+	assert(length <= kMaxLength);
+
+	auto &free = m_free[slot_size(length) / kGranularity];
+
+	std::memcpy(p, &free, sizeof(char *));
+	free = p;
+}
+
+void string_arena::merge(string_arena &&rhs)
+{
+	// keep the current block of this arena last
+	m_blocks.insert(m_blocks.end() - (m_blocks.empty() ? 0 : 1),
+		std::make_move_iterator(rhs.m_blocks.begin()), std::make_move_iterator(rhs.m_blocks.end()));
+	rhs.m_blocks.clear();
+	rhs.m_used = kBlockSize;
+
+	for (size_t i = 0; i < m_free.size(); ++i)
+	{
+		while (rhs.m_free[i] != nullptr)
+		{
+			char *p = rhs.m_free[i];
+			std::memcpy(&rhs.m_free[i], p, sizeof(char *));
+
+			std::memcpy(p, &m_free[i], sizeof(char *));
+			m_free[i] = p;
+		}
+	}
+}
+
+// --------------------------------------------------------------------
+
+const char *string_table::intern(std::string_view text)
+{
+	auto i = m_index.find(text);
+	if (i != m_index.end())
+		return m_entries[i->second].data();
+
+	uint32_t id = size();
+
+	// the id is stored in front of the text
+	std::unique_ptr<char[]> data(new char[sizeof(uint32_t) + text.length() + 1]);
+	std::memcpy(data.get(), &id, sizeof(uint32_t));
+
+	char *result = data.get() + sizeof(uint32_t);
+	std::copy(text.begin(), text.end(), result);
+	result[text.length()] = 0;
+
+	m_storage.emplace_back(std::move(data));
+	m_entries.emplace_back(result, text.length());
+	m_index.emplace(m_entries.back(), id);
+
+	return result;
+}
+
+const char *string_table::find(std::string_view text) const
+{
+	auto i = m_index.find(text);
+	return i != m_index.end() ? m_entries[i->second].data() : nullptr;
+}
+
+// --------------------------------------------------------------------
+
 row_handle s_null_row_handle;
 
 item_handle::item_handle()
@@ -52,6 +149,34 @@ std::string_view item_handle::text() const
 	return {};
 }
 
+std::errc item_handle::cached_number(double &value) const
+{
+	if (not m_row_handle.empty() and m_column < m_row_handle.m_row->size())
+		return m_row_handle.m_row->number(m_column, value);
+
+	return std::errc::invalid_argument;
+}
+
+std::errc item_handle::cached_number(float &value) const
+{
+	if (not m_row_handle.empty() and m_column < m_row_handle.m_row->size())
+		return m_row_handle.m_row->number(m_column, value);
+
+	return std::errc::invalid_argument;
+}
+
+uint32_t item_handle::interned_id() const
+{
+	if (not m_row_handle.empty())
+	{
+		auto iv = m_row_handle.m_row->get(m_column);
+		if (iv != nullptr)
+			return iv->interned_id();
+	}
+
+	return string_table::npos;
+}
+
 void item_handle::assign_value(const item &v)
 {
 	assert(not m_row_handle.empty());
@@ -2329,13 +2329,20 @@ std::string structure::create_non_poly(const std::string &entity_id, const std::
 
 	auto &res = m_non_polymers.emplace_back(*this, comp_id, asym_id, 0, asym_id, "1", "");
 
-	for (auto &atom : atoms)
+	// Reserve the ID's first, the rows are then added in bulk
+	std::vector<std::string> atom_ids;
+	for (size_t i = 0; i < atoms.size(); ++i)
+		atom_ids.emplace_back(atom_site.get_unique_id(""));
+
+	category::bulk_inserter bulk(atom_site);
+
+	for (size_t i = 0; i < atoms.size(); ++i)
 	{
-		auto atom_id = atom_site.get_unique_id("");
+		auto &atom = atoms[i];
 
-		auto row = atom_site.emplace({
+		bulk.emplace({
 			{"group_PDB", atom.get_property("group_PDB")},
-			{"id", atom_id},
+			{"id", atom_ids[i]},
 			{"type_symbol", atom.get_property("type_symbol")},
 			{"label_atom_id", atom.get_property("label_atom_id")},
 			{"label_alt_id", atom.get_property("label_alt_id")},
@@ -2356,13 +2363,18 @@ std::string structure::create_non_poly(const std::string &entity_id, const std::
 			{"auth_atom_id", atom.get_property("label_atom_id")},
 			{"pdbx_PDB_model_num", 1}
 		});
+	}
 
+	bulk.commit();
+
+	for (auto &atom_id : atom_ids)
+	{
 		auto &newAtom = emplace_atom(std::make_shared<atom::atom_impl>(m_db, atom_id));
 		res.add_atom(newAtom);
 	}
 
 	auto &pdbx_nonpoly_scheme = m_db["pdbx_nonpoly_scheme"];
-	size_t ndb_nr = pdbx_nonpoly_scheme.find("asym_id"_key == asym_id and "entity_id"_key == entity_id).size() + 1;
+	size_t ndb_nr = pdbx_nonpoly_scheme.count("asym_id"_key == asym_id and "entity_id"_key == entity_id) + 1;
 	pdbx_nonpoly_scheme.emplace({
 		{"asym_id", asym_id},
 		{"entity_id", entity_id},
@@ -2400,11 +2412,18 @@ std::string structure::create_non_poly(const std::string &entity_id, std::vector
 
 	auto &res = m_non_polymers.emplace_back(*this, comp_id, asym_id, 0, asym_id, "1", "");
 
-	for (auto &atom : atoms)
+	// Reserve the ID's first, the rows are then added in bulk
+	std::vector<std::string> atom_ids;
+	for (size_t i = 0; i < atoms.size(); ++i)
+		atom_ids.emplace_back(atom_site.get_unique_id(""));
+
+	category::bulk_inserter bulk(atom_site);
+
+	for (size_t i = 0; i < atoms.size(); ++i)
 	{
-		auto atom_id = atom_site.get_unique_id("");
+		auto &atom = atoms[i];
 
-		atom.set_value("id", atom_id);
+		atom.set_value("id", atom_ids[i]);
 		atom.set_value("label_asym_id", asym_id);
 		atom.set_value("auth_asym_id", asym_id);
 		atom.set_value("label_entity_id", entity_id);
@@ -2418,14 +2437,19 @@ std::string structure::create_non_poly(const std::string &entity_id, std::vector
 		atom.set_value_if_empty({"label_alt_id", ""});
 		atom.set_value_if_empty({"occupancy", 1.0, 2});
 
-		auto row = atom_site.emplace(atom.begin(), atom.end());
+		bulk.emplace(atom.begin(), atom.end());
+	}
 
+	bulk.commit();
+
+	for (auto &atom_id : atom_ids)
+	{
 		auto &newAtom = emplace_atom(std::make_shared<atom::atom_impl>(m_db, atom_id));
 		res.add_atom(newAtom);
 	}
 
 	auto &pdbx_nonpoly_scheme = m_db["pdbx_nonpoly_scheme"];
-	size_t ndb_nr = pdbx_nonpoly_scheme.find("asym_id"_key == asym_id and "entity_id"_key == entity_id).size() + 1;
+	size_t ndb_nr = pdbx_nonpoly_scheme.count("asym_id"_key == asym_id and "entity_id"_key == entity_id) + 1;
 	pdbx_nonpoly_scheme.emplace({
 		{"asym_id", asym_id},
 		{"entity_id", entity_id},
@@ -2488,7 +2512,7 @@ void structure::create_water(row_initializer atom)
 	atom.set_value_if_empty({"label_alt_id", ""});
 	atom.set_value_if_empty({"occupancy", 1.0, 2});
 
-	auto row = atom_site.emplace(atom.begin(), atom.end());
+	atom_site.emplace(atom.begin(), atom.end());
 
 	emplace_atom(std::make_shared<atom::atom_impl>(m_db, atom_id));
 
@@ -2836,9 +2860,9 @@ void structure::cleanup_empty_categories()
 
 		std::optional<size_t> count;
 		if (type == "polymer")
-			count = m_db["struct_asym"].find("entity_id"_key == id).size();
+			count = m_db["struct_asym"].count("entity_id"_key == id);
 		else if (type == "non-polymer" or type == "water")
-			count = m_db["pdbx_nonpoly_scheme"].find("entity_id"_key == id).size();
+			count = m_db["pdbx_nonpoly_scheme"].count("entity_id"_key == id);
 		else if (type == "branched")
 		{
 			// is this correct?
@@ -29,10 +29,21 @@
 #include "cif++/parser.hpp"
 #include "cif++/file.hpp"
 
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <iostream>
 #include <map>
 #include <stack>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CIFPP_SCANNER_X86 1
+#include <immintrin.h>
+#if _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 
 namespace cif
 {
@@ -175,6 +186,215 @@ class reserved_words_automaton
 	bool m_seen_trailing_chars = false;
 };
 
+// --------------------------------------------------------------------
+//	Scanners, used to skip over runs of characters that do not change
+//	the state of the tokenizer. Each of these returns a pointer to the
+//	first character in [b, e) that is a stop character for the class.
+//	The vectorized versions must return exactly the same as the scalar
+//	version.
+
+namespace
+{
+
+enum class scan_class
+{
+	non_blank, // stop at anything that cannot be part of a tag or unquoted value
+	blank,     // stop at anything that is not a space or tab
+	printable, // stop at anything that is not printable (including newlines)
+	quoted     // like printable, but stop at the quote character as well
+};
+
+template <scan_class C>
+inline bool is_stop_char(unsigned char ch, char quote)
+{
+	if constexpr (C == scan_class::non_blank)
+		return not sac_parser::is_non_blank(ch);
+	else if constexpr (C == scan_class::blank)
+		return ch != ' ' and ch != '\t';
+	else if constexpr (C == scan_class::printable)
+		return not sac_parser::is_any_print(ch);
+	else
+		return ch == static_cast<unsigned char>(quote) or not sac_parser::is_any_print(ch);
+}
+
+template <scan_class C>
+const char *scan_scalar(const char *b, const char *e, char quote)
+{
+	while (b != e and not is_stop_char<C>(*b, quote))
+		++b;
+	return b;
+}
+
+#if CIFPP_SCANNER_X86
+
+// Note that the comparisons are signed, which means that characters
+// with the high bit set are less than 0x20 and thus are stop characters
+
+template <scan_class C>
+inline __m128i stop_mask_sse2(__m128i v, __m128i quote)
+{
+	if constexpr (C == scan_class::non_blank)
+		return _mm_or_si128(
+			_mm_cmplt_epi8(v, _mm_set1_epi8(0x21)),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)));
+	else if constexpr (C == scan_class::blank)
+		return _mm_andnot_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+			_mm_set1_epi8(-1));
+	else
+	{
+		auto result = _mm_or_si128(
+			_mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmplt_epi8(v, _mm_set1_epi8(0x20))),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)));
+
+		if constexpr (C == scan_class::quoted)
+			result = _mm_or_si128(result, _mm_cmpeq_epi8(v, quote));
+
+		return result;
+	}
+}
+
+template <scan_class C>
+const char *scan_sse2(const char *b, const char *e, char quote)
+{
+	const auto q = _mm_set1_epi8(quote);
+
+	for (; e - b >= 16; b += 16)
+	{
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+		uint32_t mask = _mm_movemask_epi8(stop_mask_sse2<C>(v, q));
+		if (mask != 0)
+			return b + std::countr_zero(mask);
+	}
+
+	return scan_scalar<C>(b, e, quote);
+}
+
+#if defined(__GNUC__)
+#define CIFPP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CIFPP_TARGET_AVX2
+#endif
+
+template <scan_class C>
+CIFPP_TARGET_AVX2 inline __m256i stop_mask_avx2(__m256i v, __m256i quote)
+{
+	if constexpr (C == scan_class::non_blank)
+		return _mm256_or_si256(
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(0x21), v),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7f)));
+	else if constexpr (C == scan_class::blank)
+		return _mm256_andnot_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+			_mm256_set1_epi8(-1));
+	else
+	{
+		auto result = _mm256_or_si256(
+			_mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')), _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v)),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7f)));
+
+		if constexpr (C == scan_class::quoted)
+			result = _mm256_or_si256(result, _mm256_cmpeq_epi8(v, quote));
+
+		return result;
+	}
+}
+
+template <scan_class C>
+CIFPP_TARGET_AVX2 const char *scan_avx2(const char *b, const char *e, char quote)
+{
+	const auto q = _mm256_set1_epi8(quote);
+
+	for (; e - b >= 32; b += 32)
+	{
+		auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b));
+		uint32_t mask = _mm256_movemask_epi8(stop_mask_avx2<C>(v, q));
+		if (mask != 0)
+			return b + std::countr_zero(mask);
+	}
+
+	return scan_sse2<C>(b, e, quote);
+}
+
+bool cpu_supports_avx2()
+{
+#if defined(__GNUC__)
+	return __builtin_cpu_supports("avx2");
+#elif _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// AVX and OSXSAVE, and the OS should save the YMM registers
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 or (info[2] & (1 << 28)) == 0 or (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return false;
+#endif
+}
+
+#endif
+
+sac_parser::scanner_kind best_scanner()
+{
+#if CIFPP_SCANNER_X86
+	return cpu_supports_avx2() ? sac_parser::scanner_kind::avx2 : sac_parser::scanner_kind::sse2;
+#else
+	return sac_parser::scanner_kind::scalar;
+#endif
+}
+
+std::atomic<sac_parser::scanner_kind> s_scanner = best_scanner();
+std::atomic<std::size_t> s_thread_count = 0;
+
+template <scan_class C>
+inline const char *scan(const char *b, const char *e, char quote = 0)
+{
+	switch (s_scanner.load(std::memory_order_relaxed))
+	{
+#if CIFPP_SCANNER_X86
+		case sac_parser::scanner_kind::avx2: return scan_avx2<C>(b, e, quote);
+		case sac_parser::scanner_kind::sse2: return scan_sse2<C>(b, e, quote);
+#endif
+		default: return scan_scalar<C>(b, e, quote);
+	}
+}
+
+} // namespace
+
+sac_parser::scanner_kind sac_parser::get_scanner()
+{
+	return s_scanner;
+}
+
+sac_parser::scanner_kind sac_parser::set_scanner(scanner_kind kind)
+{
+	auto best = best_scanner();
+	if (kind > best)
+		kind = best;
+	s_scanner = kind;
+	return kind;
+}
+
+std::size_t sac_parser::get_thread_count()
+{
+	std::size_t result = s_thread_count;
+	if (result == 0)
+		result = std::max(std::thread::hardware_concurrency(), 1U);
+	return result;
+}
+
+void sac_parser::set_thread_count(std::size_t count)
+{
+	s_thread_count = count;
+}
+
 // --------------------------------------------------------------------
 
 sac_parser::sac_parser(std::istream &is, bool init)
@@ -192,6 +412,41 @@ sac_parser::sac_parser(std::istream &is, bool init)
 		m_lookahead = get_next_token();
 }
 
+sac_parser::sac_parser(const char *data, std::size_t length, bool init)
+	: m_buffer(new memory_buffer(data, length))
+	, m_source(*m_buffer)
+{
+	m_token_buffer.reserve(8192);
+
+	m_line_nr = 1;
+	m_bol = true;
+
+	if (init)
+		m_lookahead = get_next_token();
+}
+
+sac_parser::memory_buffer::pos_type sac_parser::memory_buffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	switch (dir)
+	{
+		case std::ios_base::beg: return seekpos(off, which);
+		case std::ios_base::cur: return seekpos((gptr() - eback()) + off, which);
+		case std::ios_base::end: return seekpos((egptr() - eback()) + off, which);
+		default: return pos_type(off_type(-1));
+	}
+}
+
+sac_parser::memory_buffer::pos_type sac_parser::memory_buffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	off_type offset = pos;
+
+	if ((which & std::ios_base::in) == 0 or offset < 0 or offset > egptr() - eback())
+		return pos_type(off_type(-1));
+
+	setg(eback(), eback() + offset, egptr());
+	return pos;
+}
+
 bool sac_parser::is_unquoted_string(std::string_view text)
 {
 	bool result = text.empty() or is_ordinary(text.front());
@@ -223,30 +478,49 @@ bool sac_parser::is_unquoted_string(std::string_view text)
 int sac_parser::get_next_char()
 {
 	int result = m_source.sbumpc();
+	int width = 1;
 
 	if (result == std::char_traits<char>::eof())
-		m_token_buffer.push_back(0);
-	else
+		width = 0;
+	else if (result == '\r')
 	{
-		if (result == '\r')
+		if (m_source.sgetc() == '\n')
 		{
-			if (m_source.sgetc() == '\n')
-				m_source.sbumpc();
-
-			++m_line_nr;
-			result = '\n';
+			m_source.sbumpc();
+			width = 2;
 		}
-		else if (result == '\n')
-			++m_line_nr;
-		
-		m_token_buffer.push_back(std::char_traits<char>::to_char_type(result));
+
+		++m_line_nr;
+		result = '\n';
+		m_token_has_cr = true;
+	}
+	else if (result == '\n')
+		++m_line_nr;
+
+	// When reading from memory, the token is not copied. We
+	// only need to remember how to undo this read in retract
+	if (m_buffer)
+	{
+		m_last_char = result;
+		m_last_width = width;
 	}
+	else
+		m_token_buffer.push_back(width == 0 ? 0 : std::char_traits<char>::to_char_type(result));
 
 	return result;
 }
 
 void sac_parser::retract()
 {
+	if (m_buffer)
+	{
+		if (m_last_char == '\n')
+			--m_line_nr;
+
+		m_buffer->unget(std::exchange(m_last_width, 0));
+		return;
+	}
+
 	assert(not m_token_buffer.empty());
 
 	char ch = m_token_buffer.back();
@@ -265,6 +539,52 @@ void sac_parser::retract()
 	m_token_buffer.pop_back();
 }
 
+void sac_parser::start_token()
+{
+	m_token_buffer.clear();
+	m_token_has_cr = false;
+	m_token_line_nr = m_line_nr;
+
+	if (m_buffer)
+		m_token_start = m_buffer->pos();
+}
+
+std::string_view sac_parser::token_text(std::size_t skip_front, std::size_t skip_back)
+{
+	std::string_view result;
+
+	if (m_buffer)
+	{
+		result = std::string_view(m_token_start, m_buffer->pos() - m_token_start);
+
+		// A token containing carriage returns needs translation
+		if (m_token_has_cr)
+		{
+			m_token_buffer.clear();
+
+			for (auto p = result.begin(); p != result.end(); ++p)
+			{
+				if (*p != '\r')
+					m_token_buffer.push_back(*p);
+				else
+				{
+					m_token_buffer.push_back('\n');
+					if (p + 1 != result.end() and p[1] == '\n')
+						++p;
+				}
+			}
+
+			result = std::string_view(m_token_buffer.data(), m_token_buffer.size());
+		}
+	}
+	else
+		result = std::string_view(m_token_buffer.data(), m_token_buffer.size());
+
+	assert(result.length() >= skip_front + skip_back);
+
+	return result.substr(skip_front, result.length() - skip_front - skip_back);
+}
+
 sac_parser::CIFToken sac_parser::get_next_token()
 {
 	const auto kEOF = std::char_traits<char>::eof();
@@ -274,11 +594,24 @@ sac_parser::CIFToken sac_parser::get_next_token()
 	State state = State::Start;
 	m_bol = false;
 
-	m_token_buffer.clear();
+	start_token();
 	m_token_value = {};
 
 	reserved_words_automaton dag;
 
+	// When reading from memory, runs of characters that cannot change the
+	// state are skipped in one go. Returns true if anything was skipped.
+	auto skip = [this](const char *(*scanner)(const char *, const char *, char), char quote = 0)
+	{
+		if (not m_buffer)
+			return false;
+
+		auto b = m_buffer->pos();
+		auto e = scanner(b, m_buffer->end(), quote);
+		m_buffer->advance(e);
+		return e != b;
+	};
+
 	while (result == CIFToken::Unknown)
 	{
 		auto ch = get_next_char();
@@ -321,10 +654,14 @@ sac_parser::CIFToken sac_parser::get_next_token()
 				{
 					state = State::Start;
 					retract();
-					m_token_buffer.clear();
+					start_token();
 				}
 				else
+				{
 					m_bol = (ch == '\n');
+					if (skip(scan<scan_class::blank>))
+						m_bol = false;
+				}
 				break;
 			
 			case State::Comment:
@@ -332,12 +669,14 @@ sac_parser::CIFToken sac_parser::get_next_token()
 				{
 					state = State::Start;
 					m_bol = true;
-					m_token_buffer.clear();
+					start_token();
 				}
 				else if (ch == kEOF)
 					result = CIFToken::Eof;
 				else if (not is_any_print(ch))
 					error("invalid character in comment");
+				else
+					skip(scan<scan_class::printable>);
 				break;
 			
 			case State::QuestionMark:
@@ -357,6 +696,8 @@ sac_parser::CIFToken sac_parser::get_next_token()
 					error("unterminated textfield");
 				else if (not is_any_print(ch) and cif::VERBOSE > 2)
 					warning("invalid character in text field '" + std::string({static_cast<char>(ch)}) + "' (" + std::to_string((int)ch) + ")");
+				else
+					skip(scan<scan_class::printable>);
 				break;
 
 			case State::TextFieldNL:
@@ -364,8 +705,7 @@ sac_parser::CIFToken sac_parser::get_next_token()
 					state = State::TextField;
 				else if (ch == ';')
 				{
-					assert(m_token_buffer.size() >= 2);
-					m_token_value = std::string_view(m_token_buffer.data() + 1, m_token_buffer.size() - 3);
+					m_token_value = token_text(1, 2);
 					result = CIFToken::Value;
 				}
 				else if (ch == kEOF)
@@ -381,6 +721,8 @@ sac_parser::CIFToken sac_parser::get_next_token()
 					state = State::QuotedStringQuote;
 				else if (not is_any_print(ch) and cif::VERBOSE > 2)
 					warning("invalid character in quoted string: '" + std::string({static_cast<char>(ch)}) + "' (" + std::to_string((int)ch) + ")");
+				else
+					skip(scan<scan_class::quoted>, quoteChar);
 				break;
 
 			case State::QuotedStringQuote:
@@ -388,10 +730,12 @@ sac_parser::CIFToken sac_parser::get_next_token()
 				{
 					retract();
 					result = CIFToken::Value;
-					if (m_token_buffer.size() < 2)
+
+					auto text = token_text();
+					if (text.length() < 2)
 						error("Invalid quoted string token");
 
-					m_token_value = std::string_view(m_token_buffer.data() + 1, m_token_buffer.size() - 2);
+					m_token_value = text.substr(1, text.length() - 2);
 				}
 				else if (ch == quoteChar)
 					;
@@ -408,8 +752,10 @@ sac_parser::CIFToken sac_parser::get_next_token()
 				{
 					retract();
 					result = CIFToken::Tag;
-					m_token_value = std::string_view(m_token_buffer.data(), m_token_buffer.size());
+					m_token_value = token_text();
 				}
+				else
+					skip(scan<scan_class::non_blank>);
 				break;
 
 			case State::Reserved:
@@ -423,7 +769,7 @@ sac_parser::CIFToken sac_parser::get_next_token()
 						{
 							retract();
 							result = CIFToken::Value;
-							m_token_value = std::string_view(m_token_buffer.data(), m_token_buffer.size());
+							m_token_value = token_text();
 						}
 						else
 							state = State::Value;
@@ -431,7 +777,7 @@ sac_parser::CIFToken sac_parser::get_next_token()
 
 					case reserved_words_automaton::data:
 						retract();
-						m_token_value = std::string_view(m_token_buffer.data() + 5, m_token_buffer.size() - 5);
+						m_token_value = token_text(5);
 						result = CIFToken::DATA;
 						break;
 
@@ -452,7 +798,7 @@ sac_parser::CIFToken sac_parser::get_next_token()
 
 					case reserved_words_automaton::save_plus:
 						retract();
-						m_token_value = std::string_view(m_token_buffer.data() + 5, m_token_buffer.size() - 5);
+						m_token_value = token_text(5);
 						result = CIFToken::SAVE_NAME;
 						break;
 
@@ -468,9 +814,10 @@ sac_parser::CIFToken sac_parser::get_next_token()
 				{
 					retract();
 					result = CIFToken::Value;
-					m_token_value = std::string_view(m_token_buffer.data(), m_token_buffer.size());
-					break;
+					m_token_value = token_text();
 				}
+				else
+					skip(scan<scan_class::non_blank>);
 				break;
 
 			default:
@@ -509,6 +856,7 @@ bool sac_parser::parse_single_datablock(const std::string &datablock)
 		string,
 		string_quote,
 		qstring,
+		token,
 		data
 	} state = start;
 
@@ -537,12 +885,20 @@ bool sac_parser::parse_single_datablock(const std::string &datablock)
 						quote = ch;
 						break;
 					case ';':
-						if (bol)
-							state = qstring;
+						state = bol ? qstring : token;
+						break;
+					default:
+						if (not is_space(ch))
+							state = token;
 						break;
 				}
 				break;
 
+			case token:
+				if (is_space(ch))
+					state = start;
+				break;
+
 			case comment:
 				if (ch == '\n')
 					state = start;
@@ -569,7 +925,7 @@ bool sac_parser::parse_single_datablock(const std::string &datablock)
 				if (is_space(ch) and dblk[si] == 0)
 					found = true;
 				else if (dblk[si++] != ch)
-					state = start;
+					state = is_space(ch) ? start : token;
 				break;
 		}
 
@@ -598,10 +954,15 @@ sac_parser::datablock_index sac_parser::index_datablocks()
 		string,
 		string_quote,
 		qstring,
+		token,
 		data,
 		data_name
 	} state = start;
 
+	// Only a data_ at the start of a token starts a datablock, the same
+	// goes for quotes and comments. Inside a token they are regular
+	// characters, as in my_data_tool or O5'.
+
 	int quote = 0;
 	bool bol = true;
 	const char dblk[] = "data_";
@@ -627,12 +988,20 @@ sac_parser::datablock_index sac_parser::index_datablocks()
 						quote = ch;
 						break;
 					case ';':
-						if (bol)
-							state = qstring;
+						state = bol ? qstring : token;
+						break;
+					default:
+						if (not is_space(ch))
+							state = token;
 						break;
 				}
 				break;
 
+			case token:
+				if (is_space(ch))
+					state = start;
+				break;
+
 			case comment:
 				if (ch == '\n')
 					state = start;
@@ -662,7 +1031,7 @@ sac_parser::datablock_index sac_parser::index_datablocks()
 					state = data_name;
 				}
 				else if (dblk[si++] != ch)
-					state = start;
+					state = is_space(ch) ? start : token;
 				break;
 
 			case data_name:
@@ -743,6 +1112,7 @@ void sac_parser::parse_datablock()
 {
 	static const std::string kUnitializedCategory("<invalid>");
 	std::string cat = kUnitializedCategory;	// intial value acts as a guard for empty category names
+	bool selected = true;
 
 	while (m_lookahead == CIFToken::LOOP or m_lookahead == CIFToken::Tag or m_lookahead == CIFToken::SAVE_NAME)
 	{
@@ -763,7 +1133,9 @@ void sac_parser::parse_datablock()
 
 					if (cat == kUnitializedCategory)
 					{
-						produce_category(catName);
+						selected = is_selected(catName);
+						if (selected)
+							produce_category(catName);
 						cat = catName;
 					}
 					else if (not iequals(cat, catName))
@@ -774,13 +1146,30 @@ void sac_parser::parse_datablock()
 					match(CIFToken::Tag);
 				}
 
+				if (not selected)
+				{
+					while (m_lookahead == CIFToken::Value)
+					{
+						for (std::size_t i = 0; i < tags.size(); ++i)
+							match(CIFToken::Value);
+					}
+				}
+				else
+					produce_loop_header(cat, tags);
+
+				if (m_buffer and m_lookahead == CIFToken::Value and not tags.empty() and get_thread_count() > 1 and
+					wants_rows(cat, tags))
+				{
+					parse_loop_body_in_chunks(cat, tags);
+				}
+
 				while (m_lookahead == CIFToken::Value)
 				{
 					produce_row();
 
-					for (auto tag : tags)
+					for (std::size_t ix = 0; ix < tags.size(); ++ix)
 					{
-						produce_item(cat, tag, m_token_value);
+						produce_loop_item(ix, cat, tags[ix], m_token_value);
 						match(CIFToken::Value);
 					}
 				}
@@ -796,14 +1185,19 @@ void sac_parser::parse_datablock()
 
 				if (not iequals(cat, catName))
 				{
-					produce_category(catName);
 					cat = catName;
-					produce_row();
+					selected = is_selected(catName);
+					if (selected)
+					{
+						produce_category(catName);
+						produce_row();
+					}
 				}
 
 				match(CIFToken::Tag);
 
-				produce_item(cat, itemName, m_token_value);
+				if (selected)
+					produce_item(cat, itemName, m_token_value);
 
 				match(CIFToken::Value);
 				break;
@@ -825,6 +1219,153 @@ void sac_parser::parse_save_frame()
 	error("A regular CIF file should not contain a save frame");
 }
 
+void sac_parser::parse_loop_body_in_chunks(const std::string &category, const std::vector<std::string> &items)
+{
+	// Only large loop_ bodies are worth the effort
+	const std::size_t kChunkSize = 256 * 1024;
+
+	const char *b = m_token_start, *e = m_buffer->end();
+
+	// The first value is the lookahead token, if it is a text field we cannot
+	// restart tokenizing there since the tokenizer needs to see the newline
+	if (static_cast<std::size_t>(e - b) < 2 * kChunkSize or *b == ';')
+		return;
+
+	// Phase one, locate the row boundaries. This only needs to know where
+	// values start and end, any errors are left to the tokenizer. When in
+	// doubt, stop and leave the rest to the regular parser.
+
+	std::vector<loop_chunk> chunks;
+
+	const char *p = b, *chunk_begin = b, *row_end = nullptr;
+	uint32_t line_nr = m_token_line_nr, chunk_line_nr = line_nr, row_end_line_nr = line_nr;
+	std::size_t value_count = 0;
+	bool bol = false;
+
+	auto add_chunk = [&]()
+	{
+		std::size_t length = row_end - chunk_begin;
+		if (row_end != e)
+			++length; // include the trailing white space
+
+		chunks.push_back({ std::string_view(chunk_begin, length), chunk_line_nr });
+
+		chunk_begin = row_end;
+		chunk_line_nr = row_end_line_nr;
+	};
+
+	for (;;)
+	{
+		// skip white space and comments
+		while (p != e)
+		{
+			if (*p == '\n' or *p == '\r')
+			{
+				if (*p++ == '\r' and p != e and *p == '\n')
+					++p;
+				++line_nr;
+				bol = true;
+			}
+			else if (*p == ' ' or *p == '\t')
+			{
+				++p;
+				bol = false;
+			}
+			else if (*p == '#')
+			{
+				while (p != e and *p != '\n' and *p != '\r')
+					++p;
+				bol = false;
+			}
+			else
+				break;
+		}
+
+		if (p == e or *p == '_')
+			break;
+
+		if (*p == '\'' or *p == '"')
+		{
+			const char quote = *p++;
+			bool closed = false;
+
+			// a quote ends the value only when followed by white space
+			while (p != e and *p != '\n' and *p != '\r')
+			{
+				if (*p++ == quote and p != e and is_white(*p))
+				{
+					closed = true;
+					break;
+				}
+			}
+
+			if (not closed)
+				break;
+		}
+		else if (*p == ';' and bol)
+		{
+			// a text field, ends at a semicolon at the start of a line
+			for (;;)
+			{
+				while (p != e and *p != '\n' and *p != '\r')
+					++p;
+
+				if (p == e)
+					break;
+
+				if (*p++ == '\r' and p != e and *p == '\n')
+					++p;
+				++line_nr;
+
+				if (p != e and *p == ';')
+					break;
+			}
+
+			if (p == e)
+				break;
+			++p;
+		}
+		else
+		{
+			const char *v = p;
+			p = scan<scan_class::non_blank>(p, e);
+
+			if (p != e and not is_space(*p))
+				break;
+
+			// reserved words end the loop, or might. Either way we're done here.
+			std::string_view value(v, p - v);
+			if (iequals(value.substr(0, 5), "data_") or iequals(value.substr(0, 5), "loop_") or
+				iequals(value.substr(0, 5), "save_") or iequals(value.substr(0, 5), "stop_") or
+				iequals(value.substr(0, 7), "global_"))
+				break;
+		}
+
+		bol = false;
+
+		// A row boundary is only useful if it is followed by white space
+		if (++value_count % items.size() == 0 and (p == e or is_space(*p)))
+		{
+			row_end = p;
+			row_end_line_nr = line_nr;
+
+			if (static_cast<std::size_t>(row_end - chunk_begin) >= kChunkSize)
+				add_chunk();
+		}
+	}
+
+	if (row_end > chunk_begin)
+		add_chunk();
+
+	// Phase two, let the implementation produce the rows
+	if (chunks.size() > 1 and produce_rows(category, items, chunks))
+	{
+		m_buffer->advance(row_end);
+		m_line_nr = row_end_line_nr;
+		m_lookahead = get_next_token();
+	}
+}
+
 // --------------------------------------------------------------------
 
 void parser::produce_datablock(std::string_view name)
@@ -869,4 +1410,151 @@ void parser::produce_item(std::string_view category, std::string_view item, std:
 	m_row[item] = m_token_value;
 }
 
+void parser::produce_loop_header(std::string_view category, const std::vector<std::string> &items)
+{
+	if (m_category == nullptr or not iequals(category, m_category->name()))
+		error("inconsistent categories in loop_");
+
+	m_loop_columns.clear();
+	for (auto &item : items)
+		m_loop_columns.push_back(m_category->add_column(item));
+}
+
+void parser::produce_loop_item(std::size_t column, std::string_view category, std::string_view item, std::string_view value)
+{
+	if (VERBOSE >= 4)
+		std::cerr << "producing _" << category << '.' << item << " -> " << value << std::endl;
+
+	assert(column < m_loop_columns.size());
+	assert(not m_row.empty());
+
+	// Without a validator and secondary indices there is no index to
+	// update and nothing to validate, so the value can be stored directly.
+	if (m_category->m_validator != nullptr or not m_category->m_secondary_indices.empty())
+		m_row[m_loop_columns[column]] = value;
+	else if (value.empty())
+		m_row.m_row->remove(m_loop_columns[column], m_category->get_arena());
+	else
+		m_category->store_value(m_row.m_row, m_loop_columns[column], value);
+}
+
+// --------------------------------------------------------------------
+// Parser for a chunk of rows in a loop_ body
+
+class parser::loop_chunk_parser : public sac_parser
+{
+  public:
+	loop_chunk_parser(const loop_chunk &chunk)
+		: sac_parser(chunk.text.data(), chunk.text.length(), false)
+	{
+		m_line_nr = chunk.line_nr;
+		m_lookahead = get_next_token();
+	}
+
+	// Call \a f for each value in the chunk, with its column number
+	template <typename F>
+	void parse(std::size_t column_count, F &&f)
+	{
+		for (std::size_t ix = 0; m_lookahead == CIFToken::Value; ix = (ix + 1) % column_count)
+		{
+			f(ix, m_token_value);
+			match(CIFToken::Value);
+		}
+
+		match(CIFToken::Eof);
+	}
+
+  private:
+	void produce_datablock(std::string_view name) override {}
+	void produce_category(std::string_view name) override {}
+	void produce_row() override {}
+	void produce_item(std::string_view category, std::string_view item, std::string_view value) override {}
+};
+
+bool parser::wants_rows(std::string_view category, const std::vector<std::string> &items)
+{
+	// Duplicate items are rare, leave them to the regular code. The same
+	// goes for interned columns, these can only be filled serially.
+	for (auto c = m_loop_columns.begin(); c != m_loop_columns.end(); ++c)
+	{
+		if (std::find(m_loop_columns.begin(), c, *c) != c or m_category->m_columns[*c].m_interned)
+			return false;
+	}
+
+	return true;
+}
+
+bool parser::produce_rows(std::string_view category, const std::vector<std::string> &items, const std::vector<loop_chunk> &chunks)
+{
+	if (VERBOSE >= 4)
+		std::cerr << "producing rows for category " << category << " in " << chunks.size() << " chunks" << std::endl;
+
+	if (m_category == nullptr or not iequals(category, m_category->name()))
+		error("inconsistent categories in loop_");
+
+	// the columns were added in produce_loop_header, see also wants_rows
+	const auto &columns = m_loop_columns;
+	assert(columns.size() == items.size());
+
+	std::vector<std::vector<row *>> rows(chunks.size());
+
+	// Each chunk allocates its rows and stores its long values in a pool of
+	// its own, these are merged into the category afterwards. Rows that
+	// are not merged are freed along with their pool.
+	std::vector<std::unique_ptr<category::row_allocator>> allocators;
+	for (std::size_t i = 0; i < chunks.size(); ++i)
+		allocators.emplace_back(new category::row_allocator(*m_category));
+
+	auto parse_chunk = [&](std::size_t i)
+	{
+		loop_chunk_parser p(chunks[i]);
+		auto &allocator = *allocators[i];
+		auto &arena = allocator.get_arena();
+		row *r = nullptr;
+
+		p.parse(columns.size(), [&](std::size_t ix, std::string_view value)
+			{
+				if (ix == 0)
+					rows[i].push_back(r = allocator.create_row());
+
+				if (not value.empty())
+					r->append(columns[ix], value, arena);
+			});
+	};
+
+	parallel_for(chunks.size(), parse_chunk, get_thread_count());
+
+	for (auto &allocator : allocators)
+		m_category->merge(*allocator);
+
+	// splice the rows into the category, in order. The key index, if any,
+	// is built once after all rows have been added.
+	try
+	{
+		cif::category::bulk_inserter bulk(*m_category);
+
+		for (auto &rs : rows)
+		{
+			for (auto &r : rs)
+				m_category->insert_impl(m_category->cend(), std::exchange(r, nullptr));
+		}
+
+		bulk.commit();
+	}
+	catch (...)
+	{
+		for (auto &rs : rows)
+		{
+			for (auto r : rs)
+				m_category->delete_row(r);
+		}
+
+		throw;
+	}
+
+	m_row = m_category->back();
+
+	return true;
+}
+
 } // namespace cif
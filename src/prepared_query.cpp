@@ -0,0 +1,149 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2024 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cif++/prepared_query.hpp"
+
+namespace cif
+{
+
+prepared_query::prepared_query(category &cat, condition &&cond)
+	: m_category(cat)
+	, m_condition(std::move(cond))
+{
+	prepare();
+}
+
+void prepared_query::prepare()
+{
+	m_condition.prepare(m_category);
+
+	m_column_count = m_category.m_columns.size();
+	m_column_layout = m_category.m_column_layout;
+}
+
+void prepared_query::bind()
+{
+	// Items not in the category resolve to the index of the next column
+	// added, prepare again once columns are added or replaced
+	if (m_column_count != m_category.m_columns.size() or m_column_layout != m_category.m_column_layout)
+		prepare();
+
+	m_condition.bind(m_category, m_values);
+
+	m_bound = true;
+	m_generation = m_category.m_generation;
+}
+
+template <typename F>
+void prepared_query::for_each(F &&f)
+{
+	// Without parameters the values do not need to be bound, it is done
+	// anyway to find the rows again after the category was modified
+	if (not m_bound or m_generation != m_category.m_generation)
+		bind();
+
+	if (m_condition.empty())
+		return;
+
+	if (auto sh = m_condition.single(); sh.has_value())
+	{
+		if (*sh)
+			f(*sh);
+	}
+	else if (auto cs = m_condition.candidates(); cs != nullptr)
+	{
+		for (auto r : *cs)
+		{
+			if (m_condition({ m_category, *r }) and not f(row_handle{ m_category, *r }))
+				break;
+		}
+	}
+	else if (auto program = m_condition.program(); program != nullptr)
+	{
+		for (auto r = program->find_next(m_category.m_head); r != nullptr; r = program->find_next(r->m_next))
+		{
+			if (not f(row_handle{ m_category, *r }))
+				break;
+		}
+	}
+	else
+	{
+		for (auto r = m_category.m_head; r != nullptr; r = r->m_next)
+		{
+			if (m_condition({ m_category, *r }) and not f(row_handle{ m_category, *r }))
+				break;
+		}
+	}
+}
+
+size_t prepared_query::count()
+{
+	size_t result = 0;
+	for_each([&result](row_handle)
+		{ ++result; return true; });
+	return result;
+}
+
+bool prepared_query::exists()
+{
+	bool result = false;
+	for_each([&result](row_handle)
+		{ result = true; return false; });
+	return result;
+}
+
+std::vector<row_handle> prepared_query::find()
+{
+	std::vector<row_handle> result;
+	for_each([&result](row_handle r)
+		{ result.push_back(r); return true; });
+	return result;
+}
+
+row_handle prepared_query::find1()
+{
+	row_handle result;
+	size_t n = 0;
+
+	// stop at the second match
+	for_each([&](row_handle r)
+		{ result = r; return ++n < 2; });
+
+	if (n != 1)
+		throw multiple_results_error();
+
+	return result;
+}
+
+row_handle prepared_query::find_first()
+{
+	row_handle result;
+	for_each([&result](row_handle r)
+		{ result = r; return false; });
+	return result;
+}
+
+} // namespace cif
@@ -0,0 +1,22 @@
+// Generated revision file
+
+#pragma once
+
+#include <ostream>
+
+const char kLibCIFPPProjectName[] = "cifpp";
+const char kLibCIFPPVersionNumber[] = "5.1.1";
+const char kLibCIFPPVersionGitTag[] = "";
+const char kLibCIFPPBuildInfo[] = "-128-NOTFOUND";
+const char kLibCIFPPBuildDate[] = "2026-10-17T11:02:23Z";
+
+inline void write_version_string(std::ostream &os, bool verbose)
+{
+	os << kLibCIFPPProjectName << " version " << kLibCIFPPVersionNumber << std::endl;
+	if (verbose)
+	{
+		os << "build: " << kLibCIFPPBuildInfo << ' ' << kLibCIFPPBuildDate << std::endl;
+		if (kLibCIFPPVersionGitTag[0] != 0)
+			os << "git tag: " << kLibCIFPPVersionGitTag << std::endl;
+	}
+}
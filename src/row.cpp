@@ -26,9 +26,127 @@
 
 #include "cif++/category.hpp"
 
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+
 namespace cif
 {
 
+void row::resize(uint16_t size, string_arena &arena)
+{
+	if (size > m_capacity)
+	{
+		uint16_t capacity = std::max<uint16_t>(size, m_capacity + m_capacity / 2);
+
+		auto items = new item_value[capacity];
+		std::move(m_items, m_items + m_size, items);
+
+		if (m_owns_items)
+			delete[] m_items;
+
+		m_items = items;
+		m_capacity = capacity;
+		m_owns_items = true;
+
+		delete[] m_numbers;
+		m_numbers = nullptr;
+	}
+
+	for (uint16_t ix = size; ix < m_size; ++ix)
+	{
+		m_items[ix].release(arena);
+		forget_number(ix);
+	}
+
+	m_size = size;
+}
+
+uint64_t row::parse_number(std::string_view text)
+{
+	double v;
+	auto r = selected_charconv<double>::from_chars(text.data(), text.data() + text.size(), v);
+
+	if (r.ec == std::errc())
+		return std::bit_cast<uint64_t>(v);
+	else
+		return r.ec == std::errc::result_out_of_range ? kOutOfRange : kInvalid;
+}
+
+std::errc row::number(uint16_t ix, double &value) const
+{
+	assert(ix < m_size);
+
+	// Concurrent readers may both allocate the cache, only one is kept
+	auto numbers = std::atomic_ref(m_numbers).load(std::memory_order_acquire);
+	if (numbers == nullptr)
+	{
+		auto cache = new uint64_t[m_capacity];
+		std::fill(cache, cache + m_capacity, kNotParsed);
+
+		if (std::atomic_ref(m_numbers).compare_exchange_strong(numbers, cache, std::memory_order_acq_rel))
+			numbers = cache;
+		else
+			delete[] cache;
+	}
+
+	std::atomic_ref slot(numbers[ix]);
+
+	auto n = slot.load(std::memory_order_relaxed);
+	if (n == kNotParsed)
+	{
+		n = parse_number(m_items[ix].text());
+		slot.store(n, std::memory_order_relaxed);
+	}
+
+	switch (n)
+	{
+		case kInvalid:
+			return std::errc::invalid_argument;
+		case kOutOfRange:
+			return std::errc::result_out_of_range;
+		default:
+			value = std::bit_cast<double>(n);
+			return std::errc();
+	}
+}
+
+std::errc row::number(uint16_t ix, float &value) const
+{
+	double d;
+	auto ec = number(ix, d);
+
+	if (ec == std::errc())
+	{
+		// Rounding the double to a float results in the float nearest to
+		// the text, unless the double lies exactly halfway between two
+		// floats. The text may not, parse it again in that case. The same
+		// goes for values outside the range of normal floats.
+		auto a = std::abs(d);
+		bool reparse = a > std::numeric_limits<float>::max() or (a != 0 and a < std::numeric_limits<float>::min());
+
+		float f = static_cast<float>(d);
+		if (not reparse and f != d)
+		{
+			double next = std::nextafter(f, d > f ? std::numeric_limits<float>::infinity() : -std::numeric_limits<float>::infinity());
+			reparse = (f + next) / 2 == d;
+		}
+
+		if (reparse)
+		{
+			auto txt = m_items[ix].text();
+			return selected_charconv<float>::from_chars(txt.data(), txt.data() + txt.size(), value).ec;
+		}
+
+		value = f;
+	}
+
+	return ec;
+}
+
+// --------------------------------------------------------------------
+
 void row_handle::assign(uint16_t column, std::string_view value, bool updateLinked, bool validate)
 {
 	if (not m_category)
@@ -0,0 +1,172 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2023 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cif++/streaming_parser.hpp"
+
+namespace cif
+{
+
+// --------------------------------------------------------------------
+
+void streaming_parser::subscribe(std::string_view category, std::vector<std::string> items, row_callback &&callback)
+{
+	auto n = items.size();
+
+	m_subscriptions.push_back({ std::string{ category }, std::move(items), std::move(callback), std::vector<value_ref>(n), {} });
+	m_active.clear();
+
+	m_category_filter.insert(std::string{ category });
+}
+
+void streaming_parser::flush()
+{
+	if (not m_in_row)
+		return;
+
+	m_in_row = false;
+
+	for (auto s : m_active)
+	{
+		m_row_values.clear();
+		for (auto &v : s->m_values)
+			m_row_values.emplace_back(v.m_data ? v.m_data : m_row_buffer.data() + v.m_offset, v.m_length);
+
+		s->m_callback(m_row_values);
+	}
+}
+
+streaming_parser::value_ref streaming_parser::store(std::string_view value)
+{
+	value_ref result{};
+
+	if (m_buffer and value.data() >= m_buffer->begin() and value.data() + value.length() <= m_buffer->end())
+		result.m_data = value.data();
+	else
+	{
+		result.m_offset = m_row_buffer.size();
+		m_row_buffer.insert(m_row_buffer.end(), value.begin(), value.end());
+	}
+
+	result.m_length = value.length();
+
+	return result;
+}
+
+void streaming_parser::produce_datablock(std::string_view name)
+{
+	flush();
+	m_active.clear();
+
+	if (m_datablock_callback)
+		m_datablock_callback(name);
+}
+
+void streaming_parser::produce_category(std::string_view name)
+{
+	flush();
+	m_active.clear();
+
+	for (auto &s : m_subscriptions)
+	{
+		if (iequals(s.m_category, name))
+		{
+			s.m_loop_map.clear();
+			m_active.push_back(&s);
+		}
+	}
+}
+
+void streaming_parser::produce_row()
+{
+	flush();
+
+	if (m_active.empty())
+		return;
+
+	for (auto s : m_active)
+		std::fill(s->m_values.begin(), s->m_values.end(), value_ref{});
+
+	m_row_buffer.clear();
+	m_in_row = true;
+}
+
+void streaming_parser::produce_item(std::string_view category, std::string_view item, std::string_view value)
+{
+	std::optional<value_ref> v;
+
+	for (auto s : m_active)
+	{
+		for (std::size_t i = 0; i < s->m_items.size(); ++i)
+		{
+			if (iequals(s->m_items[i], item))
+			{
+				if (not v)
+					v = store(value);
+				s->m_values[i] = *v;
+			}
+		}
+	}
+}
+
+void streaming_parser::produce_loop_header(std::string_view category, const std::vector<std::string> &items)
+{
+	const std::size_t kNone = std::numeric_limits<std::size_t>::max();
+
+	for (auto s : m_active)
+	{
+		s->m_loop_map.assign(items.size(), kNone);
+
+		for (std::size_t ix = 0; ix < items.size(); ++ix)
+		{
+			for (std::size_t i = 0; i < s->m_items.size(); ++i)
+			{
+				if (iequals(s->m_items[i], items[ix]))
+				{
+					s->m_loop_map[ix] = i;
+					break;
+				}
+			}
+		}
+	}
+}
+
+void streaming_parser::produce_loop_item(std::size_t column, std::string_view category, std::string_view item, std::string_view value)
+{
+	std::optional<value_ref> v;
+
+	for (auto s : m_active)
+	{
+		auto i = s->m_loop_map[column];
+		if (i < s->m_values.size())
+		{
+			if (not v)
+				v = store(value);
+			s->m_values[i] = *v;
+		}
+	}
+}
+
+} // namespace cif
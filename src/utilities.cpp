@@ -44,7 +44,10 @@
 #include <thread>
 
 #if not defined(_MSC_VER)
+#include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <termios.h>
 #endif
 
@@ -388,6 +391,127 @@ void progress_bar::message(const std::string &inMessage)
 		m_impl->message(inMessage);
 }
 
+// --------------------------------------------------------------------
+
+#if _MSC_VER
+
+mapped_file::mapped_file(const std::filesystem::path &p)
+{
+	HANDLE file = ::CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER size;
+	if (::GetFileSizeEx(file, &size) and size.QuadPart > 0)
+	{
+		m_mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_mapping != nullptr)
+		{
+			m_data = static_cast<const char *>(::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+			if (m_data != nullptr)
+				m_size = static_cast<std::size_t>(size.QuadPart);
+		}
+	}
+
+	::CloseHandle(file);
+}
+
+mapped_file::~mapped_file()
+{
+	if (m_data != nullptr)
+		::UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		::CloseHandle(m_mapping);
+}
+
+#else
+
+mapped_file::mapped_file(const std::filesystem::path &p)
+{
+	int fd = ::open(p.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (::fstat(fd, &st) == 0 and S_ISREG(st.st_mode) and st.st_size > 0)
+	{
+		void *data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			::madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+			m_data = static_cast<const char *>(data);
+			m_size = static_cast<std::size_t>(st.st_size);
+		}
+	}
+
+	::close(fd);
+}
+
+mapped_file::~mapped_file()
+{
+	if (m_data != nullptr)
+		::munmap(const_cast<char *>(m_data), m_size);
+}
+
+#endif
+
+// --------------------------------------------------------------------
+
+void parallel_for(std::size_t n, const std::function<void(std::size_t)> &f, std::size_t thread_count)
+{
+	if (thread_count == 0)
+		thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+
+	if (thread_count > n)
+		thread_count = n;
+
+	if (thread_count <= 1)
+	{
+		for (std::size_t i = 0; i < n; ++i)
+			f(i);
+		return;
+	}
+
+	std::atomic<std::size_t> next = 0;
+	std::exception_ptr error;
+	std::mutex m;
+
+	auto worker = [&]()
+	{
+		for (;;)
+		{
+			auto i = next++;
+			if (i >= n)
+				break;
+
+			try
+			{
+				f(i);
+			}
+			catch (...)
+			{
+				std::unique_lock lock(m);
+				if (not error)
+					error = std::current_exception();
+				next = n;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < thread_count; ++i)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto &t : threads)
+		t.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
 } // namespace cif
 
 // --------------------------------------------------------------------
@@ -861,6 +985,8 @@ class resource_pool
 
 	std::unique_ptr<std::istream> load(fs::path name);
 
+	fs::path locate(fs::path name);
+
   private:
 	resource_pool();
 
@@ -936,6 +1062,30 @@ std::unique_ptr<std::istream> resource_pool::load(fs::path name)
 	return result;
 }
 
+fs::path resource_pool::locate(fs::path name)
+{
+	fs::path result;
+	std::error_code ec;
+
+	if (fs::exists(name, ec) and not ec)
+		result = name;
+	else if (mLocalResources.count(name.string()) and fs::exists(mLocalResources[name.string()], ec) and not ec)
+		result = mLocalResources[name.string()];
+	else
+	{
+		for (auto &dir : mDirs)
+		{
+			if (fs::exists(dir / name, ec) and not ec)
+			{
+				result = dir / name;
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
 // --------------------------------------------------------------------
 
 void add_data_directory(std::filesystem::path dataDir)
@@ -953,4 +1103,9 @@ std::unique_ptr<std::istream> load_resource(std::filesystem::path name)
 	return resource_pool::instance().load(name);
 }
 
+std::filesystem::path locate_resource(std::filesystem::path name)
+{
+	return resource_pool::instance().locate(name);
+}
+
 } // namespace cif
@@ -235,18 +235,33 @@ int type_validator::compare(std::string_view a, std::string_view b) const
 //}
 
 void item_validator::operator()(std::string_view value) const
+{
+	std::string message;
+	if (not validate_value(value, message))
+		throw validation_error(m_category->m_name, m_tag, message);
+}
+
+bool item_validator::validate_value(std::string_view value, std::string &message) const
 {
 	if (not value.empty() and value != "?" and value != ".")
 	{
 		if (m_type != nullptr and not regex_match(value.begin(), value.end(), *m_type->m_rx))
-			throw validation_error(m_category->m_name, m_tag, "Value '" + std::string{ value } + "' does not match type expression for type " + m_type->m_name);
+		{
+			message = "Value '" + std::string{ value } + "' does not match type expression for type " + m_type->m_name;
+			return false;
+		}
 
 		if (not m_enums.empty())
 		{
 			if (m_enums.count(std::string{ value }) == 0)
-				throw validation_error(m_category->m_name, m_tag, "Value '" + std::string{ value } + "' is not in the list of allowed values");
+			{
+				message = "Value '" + std::string{ value } + "' is not in the list of allowed values";
+				return false;
+			}
 		}
 	}
+
+	return true;
 }
 
 // --------------------------------------------------------------------
@@ -0,0 +1,221 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2020 NKI/AVL, Netherlands Cancer Institute
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Timing of the operations on the index of a category, the key of which
+// consists of three items. Run it with the number of rows as argument.
+
+#include <cif++.hpp>
+#include <cif++/dictionary_parser.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+// --------------------------------------------------------------------
+
+const char kDictionary[] = R"(
+data_bench_dict.dic
+    _datablock.id	bench_dict.dic
+    _dictionary.title	bench_dict.dic
+    _dictionary.datablock_id	bench_dict.dic
+    _dictionary.version	1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+               code      char
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+               ucode     uchar
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+               int       numb
+               '[+-]?[0-9]+'
+
+save_bench
+    _category.id              bench
+    _category.mandatory_code  no
+     loop_
+    _category_key.name
+    '_bench.chain'
+    '_bench.seq'
+    '_bench.name'
+    save_
+
+save__bench.chain
+    _item.name                '_bench.chain'
+    _item.category_id         bench
+    _item.mandatory_code      yes
+    _item_type.code           code
+    save_
+
+save__bench.seq
+    _item.name                '_bench.seq'
+    _item.category_id         bench
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__bench.name
+    _item.name                '_bench.name'
+    _item.category_id         bench
+    _item.mandatory_code      yes
+    _item_type.code           ucode
+    save_
+
+save__bench.value
+    _item.name                '_bench.value'
+    _item.category_id         bench
+    _item.mandatory_code      no
+    _item_type.code           code
+    save_
+)";
+
+struct membuf : public std::streambuf
+{
+	membuf(char *text, size_t length)
+	{
+		this->setg(text, text, text + length);
+	}
+};
+
+class timer
+{
+  public:
+	timer(const char *name)
+		: m_name(name)
+		, m_start(std::chrono::steady_clock::now())
+	{
+	}
+
+	~timer()
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_start;
+		std::cout << std::left << std::setw(24) << m_name << std::right << std::fixed << std::setprecision(1)
+				  << std::setw(10) << elapsed.count() << " ms\n";
+	}
+
+  private:
+	const char *m_name;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+// --------------------------------------------------------------------
+
+int main(int argc, char *const argv[])
+{
+	size_t N = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+	membuf buffer(const_cast<char *>(kDictionary), sizeof(kDictionary) - 1);
+	std::istream is(&buffer);
+	auto validator = cif::parse_dictionary("bench", is);
+
+	cif::datablock db("bench");
+	db.set_validator(&validator);
+	auto &cat = db["bench"];
+
+	struct key_type
+	{
+		std::string chain;
+		int seq;
+		std::string name;
+	};
+
+	std::vector<key_type> keys;
+	keys.reserve(N);
+	for (size_t i = 0; i < N; ++i)
+		keys.push_back({ std::string(1, 'A' + (i % 26)), static_cast<int>(i / 26), "N" + std::to_string(i % 7) });
+
+	std::mt19937 rng(42);
+	std::shuffle(keys.begin(), keys.end(), rng);
+
+	std::cout << N << " rows\n";
+
+	{
+		timer t("emplace");
+		for (auto &k : keys)
+			cat.emplace({ { "chain", k.chain }, { "seq", k.seq }, { "name", k.name }, { "value", "x" } });
+	}
+
+	{
+		timer t("find");
+		size_t found = 0;
+		for (size_t i = 0; i < 2 * N; ++i)
+		{
+			auto &k = keys[(i * 7919) % N];
+			found += not cat[{ { "chain", k.chain }, { "seq", k.seq }, { "name", k.name } }].empty();
+		}
+		if (found != 2 * N)
+			std::cerr << "not all rows were found\n";
+	}
+
+	{
+		timer t("reorder_by_index");
+		cat.reorder_by_index();
+	}
+
+	{
+		timer t("reorder_by_index again");
+		cat.reorder_by_index();
+	}
+
+	{
+		timer t("copy");
+		cif::category copy(cat);
+	}
+
+	std::vector<key_type> erased;
+	for (auto r : cat)
+	{
+		if (erased.size() == N / 2)
+			break;
+		erased.push_back({ r["chain"].as<std::string>(), r["seq"].as<int>(), r["name"].as<std::string>() });
+	}
+	std::shuffle(erased.begin(), erased.end(), rng);
+
+	{
+		// erase at the front, erasing elsewhere walks the list of rows
+		timer t("erase");
+		for (size_t i = 0; i < N / 2; ++i)
+			cat.erase(cat.begin());
+	}
+
+	{
+		timer t("emplace");
+		for (auto &k : erased)
+		{
+			cat.emplace({ { "chain", k.chain }, { "seq", k.seq }, { "name", k.name }, { "value", "y" } });
+		}
+	}
+
+	{
+		timer t("reorder_by_index");
+		cat.reorder_by_index();
+	}
+
+	return 0;
+}
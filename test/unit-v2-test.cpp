@@ -2379,6 +2379,2072 @@ _test.text ??
 	}
 }
 
+BOOST_AUTO_TEST_CASE(parser_test_2)
+{
+	// Parsing from memory should give the same result as parsing from a stream,
+	// also when the line endings are CR/LF.
+
+	const std::string text =
+		"data_TEST\r\n"
+		"loop_\r\n"
+		"_test.id\r\n"
+		"_test.name\r\n"
+		"_test.text\r\n"
+		"1 aap 'quoted value'\r\n"
+		"2 noot\r\n"
+		";line 1\r\n"
+		"line 2\r\n"
+		";\r\n"
+		"3 mies ?\r\n"
+		"#\r\n";
+
+	std::istringstream is(text);
+	cif::file f1(is);
+	cif::file f2(text.data(), text.length());
+
+	BOOST_TEST(f1.front() == f2.front());
+
+	auto &test = f2.front()["test"];
+	BOOST_CHECK_EQUAL(test.size(), 3);
+	BOOST_CHECK_EQUAL(test.find1<std::string>(cif::key("id") == 1, "text"), "quoted value");
+	BOOST_CHECK_EQUAL(test.find1<std::string>(cif::key("id") == 2, "text"), "line 1\nline 2");
+
+	// line numbers should be counted correctly
+	const std::string bad_text = "data_TEST\r\n_test.id 1\r\n_test.name 'unterminated\r\n";
+
+	try
+	{
+		cif::file f3(bad_text.data(), bad_text.length());
+		BOOST_FAIL("Expected a parse error");
+	}
+	catch (const cif::parse_error &ex)
+	{
+		BOOST_CHECK_EQUAL(ex.what(), "parse error at line 4: unterminated quoted string");
+	}
+}
+
+// --------------------------------------------------------------------
+// The vectorized scanners should produce exactly the same tokens as the
+// scalar code used when parsing from a stream
+
+class token_recorder : public cif::sac_parser
+{
+  public:
+	token_recorder(std::istream &is)
+		: sac_parser(is)
+	{
+	}
+
+	token_recorder(const std::string &text)
+		: sac_parser(text.data(), text.length())
+	{
+	}
+
+	void produce_datablock(std::string_view name) override
+	{
+		m_tokens.emplace_back("data_" + std::string{ name });
+	}
+
+	void produce_category(std::string_view name) override
+	{
+		m_tokens.emplace_back("category " + std::string{ name });
+	}
+
+	void produce_row() override
+	{
+		m_tokens.emplace_back("row");
+	}
+
+	void produce_item(std::string_view category, std::string_view item, std::string_view value) override
+	{
+		m_tokens.emplace_back(std::string{ category } + '.' + std::string{ item } + '=' + std::string{ value });
+	}
+
+	std::vector<std::string> m_tokens;
+};
+
+BOOST_AUTO_TEST_CASE(parser_test_3)
+{
+	using scanner_kind = cif::sac_parser::scanner_kind;
+
+	const auto current = cif::sac_parser::get_scanner();
+
+	std::vector<std::string> texts{
+		// some long tokens, crossing the vector boundaries in all states
+		"data_" + std::string(40, 'x') + "\n"
+		"# a comment that is long enough to span more than one vector\t\t!\n"
+		"_test.a_somewhat_long_item_name_here " + std::string(70, 'v') + "\n"
+		"_test.b '" + std::string(45, 'q') + "\"q' \n"
+		"_test.c \"" + std::string(33, 'q') + "'\"\n"
+		"_test.d\n;" + std::string(100, 't') + "\n\t" + std::string(20, 't') + "\n;\n"
+		"_test.e                                                 tabs\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t_test.f end\n"
+	};
+
+	for (auto &e : std::filesystem::directory_iterator(gTestDir))
+	{
+		auto &p = e.path();
+		if (p.extension() == ".cif" or (p.extension() == ".gz" and p.stem().extension() == ".cif"))
+		{
+			cif::gzio::ifstream in(p);
+			BOOST_REQUIRE(in.is_open());
+
+			std::ostringstream os;
+			os << in.rdbuf();
+			texts.emplace_back(os.str());
+		}
+	}
+
+	BOOST_CHECK_GT(texts.size(), 1);
+
+	for (auto &text : texts)
+	{
+		std::istringstream is(text);
+		token_recorder stream_parser(is);
+		stream_parser.parse_file();
+
+		for (auto kind : { scanner_kind::scalar, scanner_kind::sse2, scanner_kind::avx2 })
+		{
+			if (cif::sac_parser::set_scanner(kind) != kind)
+				continue;
+
+			token_recorder memory_parser(text);
+			memory_parser.parse_file();
+
+			BOOST_TEST(stream_parser.m_tokens == memory_parser.m_tokens, boost::test_tools::per_element());
+		}
+	}
+
+	cif::sac_parser::set_scanner(current);
+}
+
+BOOST_AUTO_TEST_CASE(parser_test_4)
+{
+	// Large loop_ bodies are parsed in parallel when parsing from memory,
+	// the result should be the same as when parsing serially
+
+	const auto current = cif::sac_parser::get_thread_count();
+
+	for (std::string eol : { "\n", "\r\n" })
+	{
+		std::ostringstream os;
+		os << "data_TEST" << eol
+		   << "loop_" << eol
+		   << "_test.id" << eol
+		   << "_test.name" << eol
+		   << "_test.value" << eol
+		   << "_test.text" << eol;
+
+		for (int i = 1; i <= 50000; ++i)
+		{
+			os << i << ' ' << "name-" << (i % 97) << ' ' << (i * 0.5) << ' ';
+
+			switch (i % 5)
+			{
+				case 0: os << "'quoted #" << i << "'" << eol; break;
+				case 1: os << eol << ";text field " << i << eol << "second line" << eol << ";" << eol; break;
+				case 2: os << "?" << eol << "# comment" << eol; break;
+				case 3: os << "\"a 'quote'\"" << '\t'; break;
+				default: os << '.' << eol; break;
+			}
+		}
+
+		os << "_other.id 1" << eol;
+
+		const std::string text = os.str();
+
+		cif::sac_parser::set_thread_count(1);
+		cif::file f1(text.data(), text.length());
+
+		cif::sac_parser::set_thread_count(4);
+		cif::file f2(text.data(), text.length());
+
+		BOOST_TEST(f1.front() == f2.front());
+
+		auto &test = f2.front()["test"];
+		BOOST_CHECK_EQUAL(test.size(), 50000);
+		BOOST_CHECK_EQUAL(test.find1<std::string>(cif::key("id") == 40001, "text"), "text field 40001\nsecond line");
+		BOOST_CHECK_EQUAL(test.back()["id"].as<int>(), 50000);
+		BOOST_CHECK_EQUAL(f2.front()["other"].size(), 1);
+
+		// errors should be reported at the same line
+		auto bad_text = text;
+		bad_text.replace(bad_text.rfind("second line"), 1, "\x01");
+
+		std::string error1, error2;
+
+		cif::sac_parser::set_thread_count(1);
+		BOOST_CHECK_THROW(cif::file(bad_text.data(), bad_text.length()), cif::parse_error);
+		try { cif::file f(bad_text.data(), bad_text.length()); } catch (const std::exception &ex) { error1 = ex.what(); }
+
+		cif::sac_parser::set_thread_count(4);
+		try { cif::file f(bad_text.data(), bad_text.length()); } catch (const std::exception &ex) { error2 = ex.what(); }
+
+		BOOST_CHECK(not error1.empty());
+		BOOST_CHECK_EQUAL(error1, error2);
+	}
+
+	cif::sac_parser::set_thread_count(current);
+}
+
+BOOST_AUTO_TEST_CASE(parser_test_5)
+{
+	// Loading datablocks in parallel should give the same result as serial loading
+
+	std::ostringstream os;
+	os << "# a file with many datablocks\n";
+
+	for (int i = 0; i < 100; ++i)
+	{
+		os << "data_B" << i << "\n"
+		   << "_test.id " << i << "\n"
+		   << "_test.name 'data_ " << i << "'\n"
+		   << "loop_\n"
+		   << "_item.id\n"
+		   << "_item.text\n"
+		   << "1 a\n"
+		   << "2\n;data_X" << i << "\n;\n"
+		   << "#\n";
+	}
+
+	const std::string text = os.str();
+
+	cif::file f1(text.data(), text.length());
+
+	cif::file f2;
+	f2.load_parallel_buffer(text.data(), text.length(), 4);
+
+	BOOST_CHECK_EQUAL(f1.size(), 100);
+	BOOST_CHECK_EQUAL(f1.size(), f2.size());
+
+	auto i1 = f1.begin(), i2 = f2.begin();
+	for (; i1 != f1.end() and i2 != f2.end(); ++i1, ++i2)
+	{
+		BOOST_CHECK_EQUAL(i1->name(), i2->name());
+		BOOST_TEST(*i1 == *i2);
+	}
+
+	// Duplicate datablocks are merged
+	const std::string text2 = "data_A\n_a.x 1\ndata_B\n_b.x 1\ndata_A\n_c.x 1\n";
+
+	cif::file f3(text2.data(), text2.length());
+
+	cif::file f4;
+	f4.load_parallel_buffer(text2.data(), text2.length(), 4);
+
+	BOOST_CHECK_EQUAL(f3.size(), 2);
+	BOOST_CHECK_EQUAL(f3.size(), f4.size());
+	BOOST_TEST(f3.front() == f4.front());
+	BOOST_CHECK_EQUAL(f4.front().size(), 2);
+
+	// And errors are reported at the correct line
+	const std::string text3 = "data_A\n_a.x 1\ndata_B\n_b.x 'oops\n";
+
+	try
+	{
+		cif::file f5;
+		f5.load_parallel_buffer(text3.data(), text3.length(), 4);
+		BOOST_FAIL("Expected a parse error");
+	}
+	catch (const cif::parse_error &ex)
+	{
+		BOOST_CHECK_EQUAL(ex.what(), "parse error at line 5: unterminated quoted string");
+	}
+
+	// data_ inside a value or a tag does not start a datablock
+	const std::string text4 =
+		"data_A\n"
+		"_software.name my_data_tool\n"
+		"_software.version 1.0\n"
+		"_pdbx_audit_revision_history.data_content_type 'Structure model'\n"
+		"_x.y O5'data_C\n"
+		"data_B\n"
+		"_b.x 1\n";
+
+	cif::file f6(text4.data(), text4.length());
+
+	cif::file f7;
+	f7.load_parallel_buffer(text4.data(), text4.length(), 4);
+
+	BOOST_CHECK_EQUAL(f6.size(), 2);
+	BOOST_CHECK_EQUAL(f7.size(), 2);
+
+	auto i6 = f6.begin(), i7 = f7.begin();
+	for (; i6 != f6.end() and i7 != f7.end(); ++i6, ++i7)
+	{
+		BOOST_CHECK_EQUAL(i6->name(), i7->name());
+		BOOST_TEST(*i6 == *i7);
+	}
+
+	BOOST_CHECK_EQUAL(f7["A"]["software"].front()["name"].as<std::string>(), "my_data_tool");
+}
+
+BOOST_AUTO_TEST_CASE(parser_test_6)
+{
+	// Loading only selected categories
+
+	const std::string text = R"(data_TEST
+_cell.entry_id TEST
+_cell.length_a 10
+loop_
+_skipped.id
+_skipped.text
+1 'not wanted'
+2
+;a text field
+;
+_entity.id 1
+_other.id 1
+loop_
+_atom_site.id
+_atom_site.type_symbol
+1 C
+2 N
+#
+_skipped_too.id 1
+)";
+
+	cif::file full(text.data(), text.length());
+
+	for (auto &categories : { cif::iset{ "atom_site", "CELL", "entity" }, cif::iset{ "atom_site" } })
+	{
+		cif::file f1;
+		f1.load(text.data(), text.length(), categories);
+
+		std::istringstream is(text);
+		cif::file f2;
+		f2.load(is, categories);
+
+		for (auto f : { &f1, &f2 })
+		{
+			auto &db = f->front();
+			BOOST_CHECK_EQUAL(db.size(), categories.size());
+
+			for (auto &cat : db)
+			{
+				BOOST_CHECK(categories.count(cat.name()));
+				BOOST_TEST(cat == full.front()[cat.name()]);
+			}
+
+			BOOST_CHECK(db.get("skipped") == nullptr);
+			BOOST_CHECK(db.get("other") == nullptr);
+		}
+	}
+
+	// Errors in skipped categories are still reported
+	const std::string bad_text = "data_TEST\nloop_\n_skipped.id\n_skipped.name\n1 a\n2\n_cell.entry_id TEST\n";
+	BOOST_CHECK_THROW(cif::file().load(bad_text.data(), bad_text.length(), { "cell" }), cif::parse_error);
+}
+
+BOOST_AUTO_TEST_CASE(parser_test_7)
+{
+	// Without a validator the values of a loop_ are stored directly by
+	// column index. The result should be the same as assigning each value
+	// by name.
+
+	const std::string text = R"(data_TEST
+loop_
+_test.id
+_test.b
+_test.a
+_test.c
+1 ? . x
+2 'q r' ?
+;a text
+field
+;
+3 . '' ?
+)";
+
+	cif::file f(text.data(), text.length());
+	auto &cat = f.front()["test"];
+
+	const std::vector<std::string> columns{ "id", "b", "a", "c" };
+	const std::vector<std::vector<std::string>> rows{
+		{ "1", "", ".", "x" },
+		{ "2", "q r", "", "a text\nfield" },
+		{ "3", ".", "", "" }
+	};
+
+	cif::category expected("test");
+	for (auto &row : rows)
+	{
+		auto r = *expected.emplace({ { columns[0], row[0] } });
+		for (std::size_t i = 1; i < columns.size(); ++i)
+			r[columns[i]] = row[i];
+	}
+
+	for (uint16_t ix = 0; ix < columns.size(); ++ix)
+		BOOST_CHECK_EQUAL(cat.get_column_name(ix), columns[ix]);
+
+	BOOST_TEST(cat == expected);
+
+	auto r = cat.front();
+	BOOST_CHECK(r["b"].empty());
+	BOOST_CHECK(r["a"].is_null());
+	BOOST_CHECK_EQUAL(r["c"].text(), "x");
+
+	std::ostringstream s1, s2;
+	s1 << cat;
+	s2 << expected;
+	BOOST_CHECK_EQUAL(s1.str(), s2.str());
+}
+
+BOOST_AUTO_TEST_CASE(row_pool_1)
+{
+	using namespace cif::literals;
+
+	cif::category cat("test");
+
+	cat.emplace({ { "id", 0 }, { "name", "first" } });
+	auto first = cat.front();
+
+	for (int i = 1; i < 1000; ++i)
+		cat.emplace({ { "id", i }, { "name", "row " + std::to_string(i) } });
+
+	// handles remain valid while rows are added
+	BOOST_CHECK_EQUAL(first["name"].as<std::string>(), "first");
+	BOOST_CHECK_EQUAL(cat.size(), 1000);
+
+	// rows with more items than columns at the time of creation
+	cat.emplace({ { "id", 1000 }, { "name", "extra" }, { "a", 1 }, { "b", 2 }, { "c", 3 } });
+	BOOST_CHECK_EQUAL(cat.size(), 1001);
+	BOOST_CHECK_EQUAL(cat.find1<int>("id"_key == 1000, "c"), 3);
+
+	// erase the odd rows and the last one, then reuse the freed rows
+	BOOST_CHECK_EQUAL(cat.erase("id"_key == 1000), 1);
+	for (int i = 1; i < 1000; i += 2)
+		cat.erase("id"_key == i);
+
+	BOOST_CHECK_EQUAL(cat.size(), 500);
+	BOOST_CHECK_EQUAL(std::distance(cat.begin(), cat.end()), 500);
+	BOOST_CHECK_EQUAL(cat.back()["id"].as<int>(), 998);
+
+	for (int i = 1; i < 1000; i += 2)
+		cat.emplace({ { "id", i } });
+
+	BOOST_CHECK_EQUAL(cat.size(), 1000);
+	BOOST_CHECK_EQUAL(std::distance(cat.begin(), cat.end()), 1000);
+	BOOST_CHECK(cat.find1("id"_key == 1)["name"].empty());
+	BOOST_CHECK(cat.find("c"_key == 3).empty());
+
+	cif::category copy(cat);
+	BOOST_CHECK_EQUAL(copy.size(), 1000);
+	BOOST_TEST(copy == cat);
+
+	cat.clear();
+	BOOST_CHECK_EQUAL(cat.size(), 0);
+	BOOST_CHECK(cat.empty());
+
+	cat.emplace({ { "id", 1 } });
+	BOOST_CHECK_EQUAL(cat.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_find_1)
+{
+	using namespace cif::literals;
+
+	cif::category cat("test");
+
+	const char *names[] = { "aap", "noot", "mies", "wim" };
+
+	for (int i = 0; i < 40000; ++i)
+		cat.emplace({ { "id", i }, { "name", names[(i / 7) % 4] }, { "v", (i * 13) % 1000 } });
+
+	const auto par = cif::execution::par(4);
+
+	auto check = [&cat, par](auto make)
+	{
+		std::vector<int> expected;
+		for (auto r : cat.find(make()))
+			expected.push_back(r["id"].template as<int>());
+
+		std::vector<int> found;
+		for (auto r : cat.find(par, make()))
+			found.push_back(r["id"].template as<int>());
+
+		BOOST_CHECK(found == expected);
+		BOOST_CHECK_EQUAL(cat.find(par, make()).size(), expected.size());
+		BOOST_CHECK_EQUAL(cat.count(par, make()), expected.size());
+		BOOST_CHECK_EQUAL(cat.exists(par, make()), not expected.empty());
+		BOOST_CHECK_EQUAL(cat.count(cif::execution::seq, make()), expected.size());
+
+		return expected.size();
+	};
+
+	BOOST_CHECK_EQUAL(check([] { return "name"_key == "mies"; }), 9998);
+	BOOST_CHECK_EQUAL(check([] { return "v"_key == 999; }), 40);
+	BOOST_CHECK_EQUAL(check([] { return "v"_key == 1000; }), 0);
+	BOOST_CHECK_EQUAL(check([] { return cif::all(); }), 40000);
+	BOOST_CHECK_EQUAL(check([] { return "id"_key == 39999; }), 1);
+	check([] { return "name"_key == std::regex("[mw].*") and "v"_key > 900; });
+	check([] { return "v"_key < 10.5 or "name"_key == "wim"; });
+
+	BOOST_CHECK_EQUAL((*cat.find(par, "name"_key == "noot").offset(2).begin())["id"].as<int>(), 9);
+
+	// the same rows are erased, in the same order
+	cif::category copy(cat);
+
+	std::vector<int> erased;
+	auto n = copy.erase("v"_key < 100.0 and "name"_key != "noot", [&erased](cif::row_handle r)
+		{ erased.push_back(r["id"].as<int>()); });
+
+	std::vector<int> erased_par;
+	BOOST_CHECK_EQUAL(cat.erase(par, "v"_key < 100.0 and "name"_key != "noot", [&erased_par](cif::row_handle r)
+		{ erased_par.push_back(r["id"].as<int>()); }), n);
+	BOOST_CHECK(erased_par == erased);
+	BOOST_CHECK_EQUAL(erased.size(), n);
+	BOOST_CHECK_EQUAL(cat.size(), copy.size());
+	BOOST_CHECK(not cat.exists(par, "v"_key < 100.0 and "name"_key != "noot"));
+
+	auto ci = copy.begin();
+	for (auto r : cat)
+	{
+		if (r["id"].as<int>() != (*ci)["id"].as<int>())
+		{
+			BOOST_CHECK(false);
+			break;
+		}
+		++ci;
+	}
+
+	// small categories are tested on the calling thread
+	cif::category small("small");
+	for (int i = 0; i < 100; ++i)
+		small.emplace({ { "id", i } });
+	BOOST_CHECK_EQUAL(small.count(par, "id"_key > 49), 50);
+	BOOST_CHECK_EQUAL(small.find(par, "id"_key > 49).size(), 50);
+	BOOST_CHECK_EQUAL(small.erase(par, "id"_key > 49), 50);
+	BOOST_CHECK_EQUAL(small.size(), 50);
+}
+
+BOOST_AUTO_TEST_CASE(find_limit_1)
+{
+	using namespace cif::literals;
+
+	cif::category cat("test");
+
+	for (int i = 0; i < 3000; ++i)
+		cat.emplace({ { "id", i }, { "name", i % 3 == 0 ? "aap" : "noot" }, { "v", i % 100 } });
+
+	cif::category small("small");
+	for (int i = 0; i < 30; ++i)
+		small.emplace({ { "id", i }, { "name", i % 3 == 0 ? "aap" : "noot" }, { "v", i % 10 } });
+
+	cif::category indexed(cat);
+	indexed.create_index({ "v" });
+
+	auto ids = [](auto &&proxy)
+	{
+		std::vector<int> result;
+		for (auto r : proxy)
+			result.push_back(r["id"].template as<int>());
+		return result;
+	};
+
+	for (auto c : { &cat, &small, &indexed })
+	{
+		auto all = ids(c->find("v"_key == 7));
+		BOOST_CHECK(not all.empty());
+
+		for (size_t offset : { 0, 1, 5, 100 })
+		{
+			for (size_t limit : { 0, 1, 2, 10 })
+			{
+				std::vector<int> expected;
+				for (size_t i = offset; i < all.size() and i < offset + limit; ++i)
+					expected.push_back(all[i]);
+
+				auto h = c->find("v"_key == 7).offset(offset).limit(limit);
+				BOOST_CHECK(ids(h) == expected);
+				BOOST_CHECK_EQUAL(h.size(), expected.size());
+				BOOST_CHECK_EQUAL(h.size(), expected.size());
+				BOOST_CHECK_EQUAL(h.empty(), expected.empty());
+
+				std::vector<int> values;
+				for (auto id : c->find<int>("v"_key == 7, "id").offset(offset).limit(limit))
+					values.push_back(id);
+				BOOST_CHECK(values == expected);
+			}
+		}
+
+		BOOST_CHECK_EQUAL(c->find1("v"_key == 7 and "id"_key < 10)["id"].as<int>(), 7);
+		BOOST_CHECK_THROW(c->find1("v"_key == 7), cif::multiple_results_error);
+		BOOST_CHECK_THROW(c->find1("v"_key == 1000), cif::multiple_results_error);
+		BOOST_CHECK_THROW(c->find1<int>("v"_key == 7, "id"), cif::multiple_results_error);
+		BOOST_CHECK(not c->find1<std::optional<int>>("v"_key == 1000, "id").has_value());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(prepared_query_1)
+{
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _dictionary.title           test_dict.dic
+    _dictionary.datablock_id    test_dict.dic
+    _dictionary.version         1.0
+
+loop_
+_item_type_list.code
+_item_type_list.primitive_code
+_item_type_list.construct
+_item_type_list.detail
+code      char  '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*' 'code item types'
+ucode     uchar '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*' 'case insensitive code item types'
+float     numb  '-?(([0-9]+)|([0-9]*\.[0-9]+))([(][0-9]+[)])?([eE][+-]?[0-9]+)?' 'floating point item types'
+
+save_cat_1
+    _category.id              cat_1
+    _category.mandatory_code  no
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           code
+    save_
+
+save__cat_1.asym
+    _item.name                '_cat_1.asym'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           ucode
+    save_
+
+save__cat_1.seq
+    _item.name                '_cat_1.seq'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           float
+    save_
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	cif::file f;
+	f.set_validator(&validator);
+	f.emplace("TEST");
+
+	auto &cat = f.front()["cat_1"];
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		std::string asym(1, (i % 8 == 0 ? 'a' : 'A') + (i % 4));
+		cat.emplace({ { "id", i }, { "asym", asym }, { "seq", i % 50 == 7 ? "." : std::to_string(i / 4) } });
+	}
+
+	using namespace cif::literals;
+
+	auto ids = [](const std::vector<cif::row_handle> &rows)
+	{
+		std::vector<int> result;
+		for (auto r : rows)
+			result.push_back(r["id"].as<int>());
+		return result;
+	};
+
+	auto expected = [&cat](cif::condition &&cond)
+	{
+		std::vector<int> result;
+		for (auto r : cat.find(std::move(cond)))
+			result.push_back(r["id"].as<int>());
+		return result;
+	};
+
+	// key lookup
+	cif::prepared_query by_id(cat, "id"_key == cif::parameter(0));
+	BOOST_CHECK_THROW(by_id.count(), std::out_of_range);
+	for (int id : { 0, 17, 999, 1000 })
+		BOOST_CHECK(ids(by_id.find(id)) == expected("id"_key == id));
+	BOOST_CHECK_EQUAL(by_id.find1(42)["asym"].as<std::string>(), "C");
+	BOOST_CHECK_THROW(by_id.find1(1000), cif::multiple_results_error);
+
+	// all rows are tested, in batches
+	cif::prepared_query q(cat, "asym"_key == cif::parameter(0) and "seq"_key > cif::parameter(1));
+	BOOST_CHECK(q.get_condition().program() != nullptr);
+
+	for (auto asym : { "a", "B", "c", "d", "E" })
+	{
+		for (int seq : { 0, 100, 200, 249 })
+		{
+			auto e = expected("asym"_key == asym and "seq"_key > seq);
+			BOOST_CHECK(ids(q.find(asym, seq)) == e);
+			BOOST_CHECK_EQUAL(q.count(asym, seq), e.size());
+			BOOST_CHECK_EQUAL(q.exists(asym, seq), not e.empty());
+			BOOST_CHECK(q.find_first(asym, seq) == (e.empty() ? cif::row_handle{} : cat.find1("id"_key == e.front())));
+		}
+	}
+
+	std::ostringstream os;
+	os << q.get_condition();
+	BOOST_CHECK_EQUAL(os.str().substr(os.str().find(':') + 2), "(asym^  == $0 AND seq  > $1)");
+
+	// using an index, with the same condition tree
+	cat.create_index({ "asym", "seq" });
+
+	q.bind("b", 240);
+	BOOST_CHECK(q.get_condition().candidates() != nullptr);
+	BOOST_CHECK(ids(q.find()) == expected("asym"_key == "b" and "seq"_key > 240));
+
+	cif::prepared_query r(cat, "asym"_key == cif::parameter(0) and "seq"_key <= cif::parameter(1));
+	r.bind("C", 20.5);
+	BOOST_CHECK(r.get_condition().candidates() != nullptr);
+	BOOST_CHECK(ids(r.find()) == expected("asym"_key == "C" and "seq"_key <= 20.5));
+
+	// the values are bound again after the category was modified
+	BOOST_CHECK_EQUAL(r.count(), 21);
+	cat.erase("id"_key == 10);
+	BOOST_CHECK_EQUAL(r.count(), 20);
+	BOOST_CHECK(ids(r.find()) == expected("asym"_key == "C" and "seq"_key <= 20.5));
+
+	cif::prepared_query not_empty(cat, "seq"_key != cif::null and "asym"_key != cif::parameter(0));
+	BOOST_CHECK_EQUAL(not_empty.count("a"), cat.count("seq"_key != cif::null and "asym"_key != "a"));
+
+	// values are compared like values of the same type in a condition, text as text
+	BOOST_CHECK(ids(q.find("A", "x")) == expected("asym"_key == "A" and "seq"_key > "x"));
+	BOOST_CHECK(ids(q.find("A", 200)) == expected("asym"_key == "A" and "seq"_key > 200));
+
+	cif::prepared_query before(cat, "asym"_key < cif::parameter(0));
+	for (auto asym : { "B", "c", "x" })
+		BOOST_CHECK(ids(before.find(asym)) == expected("asym"_key < asym));
+
+	cif::prepared_query from(cat, "seq"_key >= cif::parameter(0));
+	BOOST_CHECK(ids(from.find("1.5(2)")) == expected("seq"_key >= "1.5(2)"));
+	BOOST_CHECK(ids(from.find(150.5f)) == expected("seq"_key >= 150.5f));
+	BOOST_CHECK(ids(from.find("150")) == expected("seq"_key >= "150"));
+
+	// an empty text is compared like cif::null
+	cif::prepared_query seq(cat, "seq"_key == cif::parameter(0));
+	for (int i = 0; i < 2; ++i)
+	{
+		BOOST_CHECK(ids(seq.find("")) == expected("seq"_key == cif::null));
+		BOOST_CHECK(ids(seq.find(12)) == expected("seq"_key == 12));
+	}
+	BOOST_CHECK_EQUAL(seq.count(""), 20);
+}
+
+BOOST_AUTO_TEST_CASE(prepared_query_2)
+{
+	using namespace cif::literals;
+
+	// the rows are looked up again after the category is assigned to
+	cif::category a("test");
+	for (int i = 0; i < 100; ++i)
+		a.emplace({ { "id", i }, { "v", i % 10 } });
+	a.create_index({ "v" });
+
+	cif::prepared_query q(a, "v"_key == cif::parameter(0));
+	BOOST_CHECK_EQUAL(q.count(3), 10);
+
+	{
+		cif::category b("test");
+		for (int i = 0; i < 20; ++i)
+			b.emplace({ { "id", i }, { "v", i % 4 } });
+		b.create_index({ "v" });
+
+		a = std::move(b);
+	}
+
+	BOOST_CHECK_EQUAL(q.count(), 5);
+
+	{
+		cif::category c("test");
+		for (int i = 0; i < 2000; ++i)
+			c.emplace({ { "id", i }, { "v", i % 5 } });
+
+		a = c;
+	}
+
+	BOOST_CHECK_EQUAL(q.count(), 400);
+
+	cif::category d(std::move(a));
+	BOOST_CHECK_EQUAL(q.count(), 0);
+
+	// items added after the query was prepared
+	cif::category e("test");
+	e.emplace({ { "id", 1 } });
+
+	cif::prepared_query x(e, "x"_key == cif::parameter(0));
+	BOOST_CHECK_EQUAL(x.count("A"), 0);
+
+	e.emplace({ { "id", 2 }, { "y", "A" } });
+	e.emplace({ { "id", 3 }, { "x", "B" } });
+
+	BOOST_CHECK_EQUAL(x.count("A"), e.count("x"_key == "A"));
+	BOOST_CHECK_EQUAL(x.count("B"), 1);
+
+	e = cif::category("test");
+	e.emplace({ { "x", "A" } });
+	BOOST_CHECK_EQUAL(x.count("A"), 1);
+}
+
+BOOST_AUTO_TEST_CASE(program_1)
+{
+	using namespace cif::literals;
+
+	cif::category cat("test");
+
+	const char *names[] = { "Aap", "aap", "noot", "mies", "mies" };
+
+	for (int i = 0; i < 3000; ++i)
+	{
+		std::string v = i % 17 == 0 ? "." : i % 23 == 0 ? "?" : i % 31 == 0 ? "abc" : std::to_string((i * 7) % 101) + (i % 3 ? "" : ".5");
+		cat.emplace({ { "id", i }, { "name", names[i % 5] }, { "tag", names[i % 5] }, { "v", v } });
+	}
+
+	cat.intern_column("tag");
+
+	// The compiled program finds the same rows as testing them one by one
+	auto check = [&cat](auto make)
+	{
+		cif::condition c = make();
+		c.prepare(cat);
+		BOOST_CHECK(c.program() != nullptr);
+
+		std::vector<int> expected;
+		for (auto r : cat)
+		{
+			if (c(r))
+				expected.push_back(r["id"].template as<int>());
+		}
+
+		std::vector<int> found;
+		for (auto r : cat.find(make()))
+			found.push_back(r["id"].template as<int>());
+		BOOST_CHECK(found == expected);
+
+		std::vector<int> ids;
+		for (auto id : cat.find<int>(make(), "id"))
+			ids.push_back(id);
+		BOOST_CHECK(ids == expected);
+
+		BOOST_CHECK_EQUAL(cat.count(make()), expected.size());
+		BOOST_CHECK_EQUAL(cat.exists(make()), not expected.empty());
+
+		return expected.size();
+	};
+
+	BOOST_CHECK_EQUAL(check([] { return "name"_key == "aap"; }), 600);
+	BOOST_CHECK_EQUAL(check([] { return "tag"_key == "aap"; }), 600);
+	BOOST_CHECK_EQUAL(check([] { return "name"_key == "mies" or "name"_key == cif::null; }), 1200);
+	BOOST_CHECK_EQUAL(check([] { return "v"_key == cif::null; }), 300);
+	BOOST_CHECK_EQUAL(check([] { return "v"_key != cif::null; }), 2700);
+	BOOST_CHECK_EQUAL(check([] { return "v"_key == 22; }), 17);
+
+	check([] { return "v"_key > 50.0; });
+	check([] { return "v"_key <= 20.5f; });
+	check([] { return "v"_key >= 100.0 or "v"_key == cif::null; });
+	check([] { return not("v"_key < 10.0); });
+	check([] { return ("name"_key == "mies" or "v"_key == "abc") and "id"_key > 100; });
+	check([] { return "name"_key == std::regex("[an].*") and "v"_key < 30.0; });
+	check([] { return "id"_key == 2999 or "id"_key == 0; });
+	check([] { return "id"_key == 4000; });
+	check([] { return cif::all(); });
+
+	// rows modified while iterating are evaluated again
+	size_t n = 0;
+	for (auto r : cat.find("name"_key == "noot"))
+	{
+		r["name"] = "noot";
+		if (auto next = cat.find_first("id"_key == r["id"].as<int>() + 5); next)
+			next["name"] = "wim";
+		++n;
+	}
+	BOOST_CHECK_EQUAL(n, 300);
+	BOOST_CHECK_EQUAL(cat.count("name"_key == "wim"), 300);
+
+	auto expected = cat.count("v"_key > 90.0);
+	BOOST_CHECK_EQUAL(cat.erase("v"_key > 90.0), expected);
+	BOOST_CHECK_EQUAL(cat.size(), 3000 - expected);
+	BOOST_CHECK(not cat.exists("v"_key > 90.0));
+}
+
+BOOST_AUTO_TEST_CASE(planner_1)
+{
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _dictionary.title           test_dict.dic
+    _dictionary.datablock_id    test_dict.dic
+    _dictionary.version         1.0
+
+loop_
+_item_type_list.code
+_item_type_list.primitive_code
+_item_type_list.construct
+_item_type_list.detail
+code      char  '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*' 'code item types'
+int       numb  '[+-]?[0-9]+' 'integer item types'
+
+save_cat_1
+    _category.id              cat_1
+    _category.mandatory_code  no
+    loop_
+    _category_key.name        '_cat_1.chain'
+                              '_cat_1.nr'
+    save_
+
+save__cat_1.chain
+    _item.name                '_cat_1.chain'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           code
+    save_
+
+save__cat_1.nr
+    _item.name                '_cat_1.nr'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.name
+    _item.name                '_cat_1.name'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           code
+    save_
+
+save__cat_1.flag
+    _item.name                '_cat_1.flag'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           code
+    save_
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	cif::file f;
+	f.set_validator(&validator);
+	f.emplace("TEST");
+
+	auto &cat = f.front()["cat_1"];
+
+	for (int i = 0; i < 2000; ++i)
+	{
+		cat.emplace({ { "chain", std::string(1, 'A' + i % 4) }, { "nr", i / 4 },
+			{ "name", "n-" + std::to_string(i) }, { "flag", i % 2 ? "yes" : "." } });
+	}
+
+	auto chain = cat.get_column_statistics(cat.get_column_ix("chain"));
+	BOOST_CHECK_EQUAL(chain.m_distinct, 4);
+	BOOST_CHECK_EQUAL(chain.m_empty, 0);
+
+	auto flag = cat.get_column_statistics(cat.get_column_ix("flag"));
+	BOOST_CHECK_EQUAL(flag.m_distinct, 1);
+	BOOST_CHECK_CLOSE(flag.m_empty, 0.5, 5);
+
+	auto name = cat.get_column_statistics(cat.get_column_ix("name"));
+	BOOST_CHECK_GT(name.m_distinct, 1000);
+
+	using namespace cif::literals;
+
+	auto plan = [&cat](cif::condition &&c)
+	{
+		c.prepare(cat);
+		std::ostringstream os;
+		os << c;
+		return os.str();
+	};
+
+	// the selective test comes first, the expensive one last
+	auto p = plan("name"_key == std::regex("n-1.*") and "nr"_key > 10 and "name"_key == "n-10");
+	BOOST_CHECK_EQUAL(p, "SCAN cat_1, ~0 of 2000 rows: (name  == n-10 AND nr  > 10 AND name =~ expression)");
+
+	// a conjunct covering the key uses the key index
+	p = plan("name"_key != "x" and "nr"_key == 10 and "chain"_key == "C");
+	BOOST_CHECK_EQUAL(p.substr(0, 29), "KEY cat_1, 1 candidates, ~1 o");
+	BOOST_CHECK_EQUAL(cat.count("name"_key != "x" and "nr"_key == 10 and "chain"_key == "C"), 1);
+	BOOST_CHECK_EQUAL(cat.count("name"_key == "x" and "nr"_key == 10 and "chain"_key == "C"), 0);
+
+	// the most selective index is used
+	cat.create_index({ "chain" });
+	cat.create_index({ "name" });
+
+	cif::condition c = "chain"_key == "B" and "name"_key == "n-5";
+	c.prepare(cat);
+	BOOST_CHECK(c.candidates() != nullptr and c.candidates()->size() == 1);
+	p = plan("chain"_key == "B" and "name"_key == "n-5");
+	BOOST_CHECK_EQUAL(p.substr(0, 16), "INDEX cat_1(name");
+	BOOST_CHECK_EQUAL(cat.count("chain"_key == "B" and "name"_key == "n-5"), 1);
+
+	// an index that finds half of the rows is not used
+	cat.create_index({ "flag" });
+
+	cif::condition c2 = "flag"_key == "yes";
+	c2.prepare(cat);
+	BOOST_CHECK(c2.candidates() == nullptr);
+	BOOST_CHECK_EQUAL(cat.count("flag"_key == "yes"), 1000);
+
+	cif::condition c3 = "chain"_key == "D" or "name"_key == "n-2";
+	c3.prepare(cat);
+	BOOST_CHECK(c3.candidates() != nullptr and c3.candidates()->size() == 501);
+	BOOST_CHECK_EQUAL(cat.count("chain"_key == "D" or "name"_key == "n-2"), 501);
+
+	// const readers estimate the statistics concurrently
+	for (int i = 2000; i < 4004; ++i)
+		cat.emplace({ { "chain", "E" }, { "nr", i }, { "name", "n-" + std::to_string(i) } });
+
+	std::vector<cif::column_statistics> concurrent(4);
+	cif::parallel_for(concurrent.size(), [&](size_t i)
+		{ concurrent[i] = cat.get_column_statistics(cat.get_column_ix("chain")); }, concurrent.size());
+
+	for (auto &stats : concurrent)
+		BOOST_CHECK_EQUAL(stats.m_distinct, 5);
+}
+
+BOOST_AUTO_TEST_CASE(link_index_1)
+{
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _dictionary.title           test_dict.dic
+    _dictionary.datablock_id    test_dict.dic
+    _dictionary.version         1.0
+
+loop_
+_item_type_list.code
+_item_type_list.primitive_code
+_item_type_list.construct
+_item_type_list.detail
+code      char  '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*' 'code item types'
+int       numb  '[+-]?[0-9]+' 'integer item types'
+
+save_cat_1
+    _category.id              cat_1
+    _category.mandatory_code  yes
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.id_2
+    _item.name                '_cat_1.id_2'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           int
+    save_
+
+save_cat_2
+    _category.id              cat_2
+    _category.mandatory_code  no
+    _category_key.name        '_cat_2.id'
+    save_
+
+save__cat_2.id
+    _item.name                '_cat_2.id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_2.parent_id
+    _item.name                '_cat_2.parent_id'
+    _item.category_id         cat_2
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_2.parent_id_2
+    _item.name                '_cat_2.parent_id_2'
+    _item.category_id         cat_2
+    _item.mandatory_code      no
+    _item_type.code           code
+    save_
+
+loop_
+_pdbx_item_linked_group_list.child_category_id
+_pdbx_item_linked_group_list.link_group_id
+_pdbx_item_linked_group_list.child_name
+_pdbx_item_linked_group_list.parent_name
+_pdbx_item_linked_group_list.parent_category_id
+cat_2 1 '_cat_2.parent_id'  '_cat_1.id' cat_1
+cat_2 1 '_cat_2.parent_id_2' '_cat_1.id_2' cat_1
+
+loop_
+_pdbx_item_linked_group.category_id
+_pdbx_item_linked_group.link_group_id
+_pdbx_item_linked_group.label
+cat_2 1 cat_2:cat_1:1
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	cif::file f;
+	f.set_validator(&validator);
+	f.emplace("TEST");
+
+	auto &db = f.front();
+
+	for (int i = 1; i <= 20; ++i)
+	{
+		db["cat_1"].emplace({ { "id", i }, { "id_2", i % 5 == 0 ? "?" : std::to_string(i % 3) } });
+
+		for (int j = 0; j < 10; ++j)
+			db["cat_2"].emplace({ { "id", i * 10 + j }, { "parent_id", i }, { "parent_id_2", j % 4 == 0 ? "." : std::to_string(j % 3) } });
+	}
+
+	// now that both categories exist, the links can be resolved
+	db.set_validator(&validator);
+
+	// a copy without link indices gives the expected results
+	cif::datablock plain(db);
+
+	db.create_link_indices();
+
+	BOOST_CHECK(db["cat_2"].has_index({ "parent_id", "parent_id_2" }));
+	BOOST_CHECK(db["cat_1"].has_index({ "id", "id_2" }));
+	BOOST_CHECK(not plain["cat_2"].has_index({ "parent_id", "parent_id_2" }));
+
+	using namespace cif::literals;
+
+	auto cond = "parent_id"_key == 1 and ("parent_id_2"_key == 1 or "parent_id_2"_key == cif::null);
+	cond.prepare(db["cat_2"]);
+	BOOST_CHECK(cond.candidates() != nullptr);
+
+	auto children = [](cif::datablock &d)
+	{
+		std::vector<int> result;
+		for (auto r : d["cat_1"])
+		{
+			for (auto c : d["cat_1"].get_children(r, d["cat_2"]))
+				result.push_back(c["id"].as<int>());
+			result.push_back(-1);
+		}
+		return result;
+	};
+
+	auto parents = [](cif::datablock &d)
+	{
+		std::vector<int> result;
+		for (auto r : d["cat_2"])
+		{
+			for (auto p : d["cat_2"].get_parents(r, d["cat_1"]))
+				result.push_back(p["id"].as<int>());
+			result.push_back(-1);
+		}
+		return result;
+	};
+
+	BOOST_CHECK(children(db) == children(plain));
+	BOOST_CHECK(parents(db) == parents(plain));
+
+	// cascading renames and erases
+	for (auto d : { &db, &plain })
+	{
+		auto &cat1 = (*d)["cat_1"];
+
+		cat1.find1("id"_key == 1)["id"] = 100;
+		cat1.find1("id"_key == 5)["id"] = 500;
+		cat1.find1("id"_key == 7)["id_2"] = 2;
+		cat1.erase("id"_key == 3 or "id"_key == 10);
+	}
+
+	BOOST_CHECK(db["cat_2"] == plain["cat_2"]);
+	BOOST_CHECK_EQUAL(db["cat_2"].count("parent_id"_key == 100), 5);
+	BOOST_CHECK(db["cat_2"].exists("parent_id"_key == 500));
+	BOOST_CHECK(children(db) == children(plain));
+}
+
+BOOST_AUTO_TEST_CASE(secondary_index_1)
+{
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _dictionary.title           test_dict.dic
+    _dictionary.datablock_id    test_dict.dic
+    _dictionary.version         1.0
+
+loop_
+_item_type_list.code
+_item_type_list.primitive_code
+_item_type_list.construct
+_item_type_list.detail
+code      char  '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*' 'code item types'
+ucode     uchar '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*' 'case insensitive code item types'
+float     numb  '-?(([0-9]+)|([0-9]*\.[0-9]+))([(][0-9]+[)])?([eE][+-]?[0-9]+)?' 'floating point item types'
+
+save_cat_1
+    _category.id              cat_1
+    _category.mandatory_code  no
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           code
+    save_
+
+save__cat_1.asym
+    _item.name                '_cat_1.asym'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           ucode
+    save_
+
+save__cat_1.seq
+    _item.name                '_cat_1.seq'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           float
+    save_
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	cif::file f;
+	f.set_validator(&validator);
+	f.emplace("TEST");
+
+	auto &cat = f.front()["cat_1"];
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		std::string asym(1, (i % 8 == 0 ? 'a' : 'A') + (i % 4));
+		cat.emplace({ { "id", i }, { "asym", asym }, { "seq", i % 50 == 7 ? "." : std::to_string(i / 4) } });
+	}
+
+	cat.create_index({ "asym", "seq" });
+	BOOST_CHECK(cat.has_index({ "asym", "seq" }));
+	BOOST_CHECK(not cat.has_index({ "seq" }));
+
+	// A copy without index gives the expected results
+	auto expected = [&cat](auto make)
+	{
+		cif::category plain(cat);
+		plain.drop_index({ "asym", "seq" });
+		BOOST_CHECK(not plain.has_index({ "asym", "seq" }));
+
+		std::vector<std::string> result;
+		for (auto r : plain.find(make()))
+			result.push_back(r["id"].template as<std::string>());
+		return result;
+	};
+
+	auto check = [&](auto make, bool indexed)
+	{
+		cif::condition c = make();
+		c.prepare(cat);
+		BOOST_CHECK_EQUAL(c.candidates() != nullptr, indexed);
+
+		std::vector<std::string> found;
+		for (auto r : cat.find(make()))
+			found.push_back(r["id"].template as<std::string>());
+
+		auto e = expected(make);
+		BOOST_CHECK(found == e);
+		BOOST_CHECK_EQUAL(cat.count(make()), e.size());
+		BOOST_CHECK_EQUAL(cat.exists(make()), not e.empty());
+
+		return e.size();
+	};
+
+	using namespace cif::literals;
+
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "b"; }, true), 250);
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "B" and "seq"_key == 10; }, true), 1);
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "C" and "seq"_key > 200; }, true), 49);
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "C" and "seq"_key < 20; }, true), 20);
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "A" and "seq"_key >= 100.5 and "seq"_key <= 120; }, true), 20);
+	BOOST_CHECK_EQUAL(check([] { return "seq"_key < 20; }, false), 78);
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "A" or "seq"_key == 10; }, false), 253);
+
+	// updates are reflected in the index
+	for (auto r : cat.find("asym"_key == "D" and "seq"_key < 10))
+		r["asym"] = "E";
+	cat.erase("asym"_key == "B" and "seq"_key >= 240);
+
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "E"; }, true), 9);
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "B"; }, true), 230);
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "D" and "seq"_key > 5; }, true), 241);
+
+	// rows are returned in the order of the category
+	cat.sort([](cif::row_handle a, cif::row_handle b) { return b["id"].as<int>() - a["id"].as<int>(); });
+	cat.emplace({ { "id", 1000 }, { "asym", "A" }, { "seq", "11.5" } });
+
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "A" and "seq"_key > 10.0; }, true), 240);
+
+	// seq is no longer an integer in all rows, comparing it with an
+	// integer can only use the index for the asym
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "A" and "seq"_key > 10; }, true), 240);
+	BOOST_CHECK_EQUAL(check([] { return "asym"_key == "A" and "seq"_key == 11.5; }, true), 1);
+}
+
+BOOST_AUTO_TEST_CASE(index_1)
+{
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _dictionary.title           test_dict.dic
+    _dictionary.datablock_id    test_dict.dic
+    _dictionary.version         1.0
+
+loop_
+_item_type_list.code
+_item_type_list.primitive_code
+_item_type_list.construct
+_item_type_list.detail
+code      char  '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*' 'code item types'
+ucode     uchar '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*' 'case insensitive code item types'
+float     numb  '-?(([0-9]+)|([0-9]*\.[0-9]+))([(][0-9]+[)])?([eE][+-]?[0-9]+)?' 'floating point item types'
+
+save_cat_1
+    _category.id              cat_1
+    _category.mandatory_code  no
+    loop_
+    _category_key.name
+    '_cat_1.nr'
+    '_cat_1.name'
+    save_
+
+save__cat_1.nr
+    _item.name                '_cat_1.nr'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           float
+    save_
+
+save__cat_1.name
+    _item.name                '_cat_1.name'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           ucode
+    save_
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	cif::file f;
+	f.set_validator(&validator);
+	f.emplace("TEST");
+
+	auto &cat = f.front()["cat_1"];
+
+	for (int i = 0; i < 1000; ++i)
+		cat.emplace({ { "nr", 1000 - i }, { "name", "n" + std::to_string(i % 7) } });
+
+	// Keys are compared by their type, numbers by value and ucode
+	// case insensitive
+	auto exists = [&cat](std::string nr, std::string name)
+	{
+		return static_cast<bool>(cat[{ { "nr", nr }, { "name", name } }]);
+	};
+
+	BOOST_CHECK(exists("10.0", "N3"));
+	BOOST_CHECK(not exists("10.0", "N4"));
+	BOOST_CHECK_THROW(cat.emplace({ { "nr", "1e1" }, { "name", "n3" } }), cif::duplicate_key_error);
+
+	// erase every other row and check the rest is still found
+	for (auto i = cat.begin(); i != cat.end();)
+	{
+		i = cat.erase(i);
+		if (i != cat.end())
+			++i;
+	}
+
+	BOOST_CHECK_EQUAL(cat.size(), 500);
+	BOOST_CHECK(cat.is_valid());
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		bool found = exists(std::to_string(1000 - i), "n" + std::to_string(i % 7));
+		BOOST_CHECK_EQUAL(found, i % 2 == 1);
+	}
+
+	cat.emplace({ { "nr", "-1.5" }, { "name", "B" } });
+	cat.emplace({ { "nr", "-1.5" }, { "name", "a" } });
+	cat.emplace({ { "nr", "-10" }, { "name", "a" } });
+	cat.emplace({ { "nr", "0.5" }, { "name", "a" } });
+	BOOST_CHECK_THROW(cat.emplace({ { "nr", "-1.50" }, { "name", "b" } }), cif::duplicate_key_error);
+
+	cat.reorder_by_index();
+
+	auto i = cat.begin();
+	for (auto [nr, name] : std::initializer_list<std::tuple<std::string, std::string>>{
+			 { "-10", "a" }, { "-1.5", "a" }, { "-1.5", "B" }, { "0.5", "a" } })
+	{
+		BOOST_CHECK_EQUAL((*i)["nr"].as<std::string>(), nr);
+		BOOST_CHECK_EQUAL((*i)["name"].as<std::string>(), name);
+		++i;
+	}
+
+	double last = 0;
+	for (; i != cat.end(); ++i)
+	{
+		auto nr = (*i)["nr"].as<double>();
+		BOOST_CHECK_LT(last, nr);
+		last = nr;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(column_ref_1)
+{
+	cif::category cat("test");
+	cat.emplace({ { "id", 1 }, { "Name", "aap" } });
+	cat.emplace({ { "id", 2 }, { "Name", "noot" } });
+
+	BOOST_CHECK_EQUAL(cat.get_column_ix("NAME"), 1);
+	BOOST_CHECK_EQUAL(cat.get_column_ix("xyz"), 2);
+
+	cif::column_ref name(cat, "name");
+	cif::column_handle<int> id(cat, "ID");
+	cif::column_handle<float> x(cat, "x");
+
+	BOOST_CHECK(name.exists());
+	BOOST_CHECK(not x.exists());
+
+	int sum = 0;
+	for (auto r : cat)
+	{
+		sum += id(r);
+		BOOST_CHECK_EQUAL(x(r), 0);
+		BOOST_CHECK(r[x].empty());
+	}
+	BOOST_CHECK_EQUAL(sum, 3);
+	BOOST_CHECK_EQUAL(cat.front()[name].as<std::string>(), "aap");
+
+	// a column added later is found, and does not alias a column
+	// added before it
+	cif::column_ref y(cat, "y");
+	cat.front()["z"] = 1;
+	cat.front()["x"] = 1.5f;
+
+	BOOST_CHECK(x.exists());
+	BOOST_CHECK(not y.exists());
+	BOOST_CHECK_EQUAL(x(cat.front()), 1.5f);
+	BOOST_CHECK(cat.front()[y].empty());
+
+	// assigning replaces the columns, with the same number of columns but
+	// in a different order
+	cif::category other("test");
+	other.emplace({ { "x", 2.5f }, { "z", 3 }, { "Name", "wim" }, { "id", 4 } });
+	BOOST_REQUIRE_EQUAL(other.get_columns().size(), cat.get_columns().size());
+
+	for (auto assign : { 0, 1 })
+	{
+		if (assign == 0)
+			cat = other;
+		else
+		{
+			cif::category tmp(other);
+			cat = std::move(tmp);
+		}
+
+		BOOST_CHECK_EQUAL(name.index(), cat.get_column_ix("name"));
+		BOOST_CHECK_EQUAL(cat.front()[name].as<std::string>(), "wim");
+		BOOST_CHECK_EQUAL(id(cat.front()), 4);
+		BOOST_CHECK_EQUAL(x(cat.front()), 2.5f);
+		BOOST_CHECK(not y.exists());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(cached_number_1)
+{
+	cif::category cat("test");
+	cat.emplace({ { "id", 1 }, { "x", 1.5 }, { "y", "abc" } });
+	cat.emplace({ { "id", 2 }, { "x", 2.5 }, { "y", "1e999" } });
+
+	auto r = cat.front();
+	BOOST_CHECK_EQUAL(r["x"].as<double>(), 1.5);
+	BOOST_CHECK_EQUAL(r["x"].as<float>(), 1.5f);
+	BOOST_CHECK_EQUAL(r["x"].as<int>(), 1);
+
+	// the cached number is forgotten when the value changes
+	r["x"] = 3.25;
+	BOOST_CHECK_EQUAL(r["x"].as<double>(), 3.25);
+	BOOST_CHECK_EQUAL(r["x"].compare(3.25), 0);
+
+	// values that are not numbers
+	BOOST_CHECK_EQUAL(r["y"].as<double>(), 0);
+	BOOST_CHECK_EQUAL(r["y"].compare(1.0), 1);
+	BOOST_CHECK_EQUAL(cat.back()["y"].as<double>(), 0);
+
+	BOOST_CHECK_EQUAL(cat.count(cif::key("x") > 3.0), 1);
+	BOOST_CHECK_EQUAL(cat.count(cif::key("x") < 3.0), 1);
+
+	auto b = cat.back();
+	swap(b["x"], r["x"]);
+	BOOST_CHECK_EQUAL(r["x"].as<double>(), 2.5);
+	BOOST_CHECK_EQUAL(b["x"].as<double>(), 3.25);
+
+	r["x"] = ".";
+	BOOST_CHECK_EQUAL(r["x"].as<double>(), 0);
+	BOOST_CHECK(r["x"].empty());
+
+	// values out of the range of a float are not converted into one
+	r["y"] = "1e39";
+	BOOST_CHECK_EQUAL(r["y"].as<double>(), 1e39);
+	BOOST_CHECK_EQUAL(r["y"].as<float>(), 0.f);
+	BOOST_CHECK_EQUAL(r["y"].compare(1.0f), 1);
+	BOOST_CHECK_EQUAL(cat.count(cif::key("y") < 2.0f), 0);
+	BOOST_CHECK_EQUAL(cat.count(cif::key("y") < 2e39), 1);
+
+	// numbers can be read from a const category, on multiple threads
+	const auto &ccat = cat;
+	BOOST_CHECK_EQUAL(ccat.front()["y"].as<double>(), 1e39);
+
+	cif::category many("test");
+	for (int i = 0; i < 1000; ++i)
+		many.emplace({ { "id", i }, { "x", i + 0.5 } });
+
+	std::vector<double> sums(4);
+	cif::parallel_for(sums.size(), [&](size_t i)
+		{
+		for (auto r : std::as_const(many))
+			sums[i] += r["x"].as<double>(); }, sums.size());
+
+	for (auto sum : sums)
+		BOOST_CHECK_EQUAL(sum, 500000);
+
+	// A float is the float nearest to the text, even if the nearest
+	// double lies halfway between two floats
+	r["x"] = "1.0000000596046447753906250000000001";
+	BOOST_CHECK_EQUAL(r["x"].as<double>(), 1 + std::ldexp(1.0, -24));
+	BOOST_CHECK_EQUAL(r["x"].as<float>(), std::nextafter(1.0f, 2.0f));
+	BOOST_CHECK_EQUAL(r["x"].compare(std::nextafter(1.0f, 2.0f)), 0);
+}
+
+BOOST_AUTO_TEST_CASE(column_store_1)
+{
+	auto f = R"(data_TEST
+loop_
+_atom_site.id
+_atom_site.label_atom_id
+_atom_site.Cartn_x
+_atom_site.B_iso_or_equiv
+1 N  1.5   10.2(3)
+2 CA -2    ?
+3 C  3.25  .
+)"_cf;
+
+	auto &cat = f.front()["atom_site"];
+	auto &cs = cat.get_column_store();
+
+	BOOST_CHECK_EQUAL(cs.size(), 3);
+
+	auto &atom_id = cs.text("label_atom_id");
+	BOOST_CHECK_EQUAL(atom_id.size(), 3);
+	BOOST_CHECK_EQUAL(atom_id[1], "CA");
+	BOOST_CHECK_EQUAL(atom_id.text(), "NCAC");
+	BOOST_CHECK_EQUAL(atom_id.offsets()[2], 3);
+
+	// without dictionary, numeric columns are detected
+	BOOST_CHECK(not cs.is_numeric("label_atom_id"));
+	BOOST_CHECK_THROW(cs.numbers("label_atom_id"), std::invalid_argument);
+	BOOST_CHECK_THROW(cs.text("xyz"), std::out_of_range);
+
+	auto x = cs.numbers("Cartn_x");
+	BOOST_CHECK_EQUAL(x.size(), 3);
+	BOOST_CHECK_EQUAL(x[0], 1.5);
+	BOOST_CHECK_EQUAL(x[1], -2);
+	BOOST_CHECK_EQUAL(x[2], 3.25);
+
+	auto b = cs.numbers("B_iso_or_equiv");
+	BOOST_CHECK_EQUAL(b[0], 10.2);
+	BOOST_CHECK(std::isnan(b[1]) and std::isnan(b[2]));
+
+	// a modification invalidates the column store
+	cat.find1(cif::key("id") == 2)["Cartn_x"] = 7.5;
+	BOOST_CHECK_EQUAL(cat.get_column_store().numbers("Cartn_x")[1], 7.5);
+
+	cat.emplace({ { "id", 4 }, { "label_atom_id", "O" } });
+	BOOST_CHECK_EQUAL(cat.get_column_store().text("label_atom_id")[3], "O");
+	BOOST_CHECK(std::isnan(cat.get_column_store().numbers("Cartn_x")[3]));
+
+	// const readers share the same column store
+	cat.emplace({ { "id", 5 }, { "label_atom_id", "N" } });
+
+	std::vector<const cif::column_store *> stores(4);
+	cif::parallel_for(stores.size(), [&](size_t i)
+		{ stores[i] = &std::as_const(cat).get_column_store(); }, stores.size());
+
+	for (auto store : stores)
+		BOOST_CHECK_EQUAL(store, stores.front());
+	BOOST_CHECK_EQUAL(stores.front()->size(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(intern_1)
+{
+	const char *kAtoms[] = { "N", "CA", "C", "O", "a rather long atom name" };
+
+	cif::category cat("atom_site");
+	for (int i = 0; i < 100; ++i)
+		cat.emplace({ { "id", i + 1 }, { "label_atom_id", kAtoms[i % 5] }, { "label_comp_id", "ALA" } });
+
+	cat.intern_column("label_comp_id");
+	BOOST_CHECK(cat.is_interned("label_comp_id"));
+	BOOST_CHECK(not cat.is_interned("label_atom_id"));
+
+	// id is unique, label_atom_id has five distinct values
+	cat.intern_repeated_values(10);
+	BOOST_CHECK(not cat.is_interned("id"));
+	BOOST_CHECK(cat.is_interned("label_atom_id"));
+
+	BOOST_CHECK_EQUAL(cat.count(cif::key("label_atom_id") == "CA"), 20);
+	BOOST_CHECK_EQUAL(cat.count(cif::key("label_atom_id") == "a rather long atom name"), 20);
+	BOOST_CHECK_EQUAL(cat.count(cif::key("label_atom_id") == "CB"), 0);
+	BOOST_CHECK_EQUAL(cat.count(cif::key("label_comp_id") == "ALA" and cif::key("label_atom_id") == "O"), 20);
+
+	// new values, also for rows added later
+	cat.find1(cif::key("id") == 1)["label_atom_id"] = "CB";
+	cat.emplace({ { "id", 101 }, { "label_atom_id", "CB" }, { "label_comp_id", "GLY" } });
+
+	BOOST_CHECK_EQUAL(cat.count(cif::key("label_atom_id") == "N"), 19);
+	BOOST_CHECK_EQUAL(cat.count(cif::key("label_atom_id") == "CB"), 2);
+	BOOST_CHECK_EQUAL(cat.find1<std::string>(cif::key("id") == 101, "label_comp_id"), "GLY");
+
+	// a copy has its own table
+	cif::category copy(cat);
+	cat.clear();
+	BOOST_CHECK(copy.is_interned("label_atom_id"));
+	BOOST_CHECK_EQUAL(copy.count(cif::key("label_atom_id") == "CB"), 2);
+	BOOST_CHECK_EQUAL(copy.find1<std::string>(cif::key("id") == 5, "label_atom_id"), "a rather long atom name");
+}
+
+BOOST_AUTO_TEST_CASE(string_arena_1)
+{
+	cif::string_arena arena;
+
+	auto a = arena.allocate(10);
+	auto b = arena.allocate(20);
+	BOOST_CHECK(a != nullptr and b != nullptr and a != b);
+	BOOST_CHECK(arena.allocate(cif::string_arena::kMaxLength + 1) == nullptr);
+
+	// released space is reused for values of about the same size
+	arena.deallocate(a, 10);
+	BOOST_CHECK_EQUAL(arena.allocate(12), a);
+	BOOST_CHECK(arena.allocate(10) != a);
+
+	cif::string_arena other;
+	auto c = other.allocate(30);
+	other.deallocate(c, 30);
+	arena.merge(std::move(other));
+	BOOST_CHECK_EQUAL(arena.allocate(30), c);
+
+	// long values in a category, overwritten many times
+	cif::category cat("test");
+	for (int i = 0; i < 100; ++i)
+		cat.emplace({ { "id", i }, { "x", "a long value " + std::to_string(i) } });
+
+	for (int j = 0; j < 10; ++j)
+	{
+		for (auto r : cat)
+			r["x"] = "another long value " + std::to_string(j) + ' ' + r["id"].as<std::string>();
+	}
+
+	int i = 0;
+	for (const auto &[id, x] : cat.rows<int, std::string>("id", "x"))
+	{
+		BOOST_CHECK_EQUAL(id, i);
+		BOOST_CHECK_EQUAL(x, "another long value 9 " + std::to_string(i));
+		++i;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(streaming_parser_1)
+{
+	const std::string text = R"(data_ONE
+_cell.entry_id ONE
+_cell.length_a 10.5
+loop_
+_atom_site.id
+_atom_site.type_symbol
+_atom_site.B_iso_or_equiv
+1 C 12.5
+2 N ?
+3 'O' 7
+_other.id 1
+data_TWO
+_cell.length_b 11
+_cell.entry_id TWO
+loop_
+_atom_site.type_symbol
+_atom_site.id
+S 1
+)";
+
+	for (bool in_memory : { false, true })
+	{
+		std::istringstream is(text);
+		std::unique_ptr<cif::streaming_parser> p;
+		if (in_memory)
+			p.reset(new cif::streaming_parser(text.data(), text.length()));
+		else
+			p.reset(new cif::streaming_parser(is));
+
+		std::vector<std::string> datablocks, cells, atoms;
+		std::vector<std::optional<float>> b_factors;
+
+		p->on_datablock([&](std::string_view name)
+			{ datablocks.emplace_back(name); });
+
+		p->subscribe("cell", { "entry_id", "length_a" }, [&](const std::vector<std::string_view> &values)
+			{
+				BOOST_REQUIRE_EQUAL(values.size(), 2);
+				cells.emplace_back(std::string{ values[0] } + '/' + std::string{ values[1] });
+
+				// values are not copied when parsing from memory
+				if (in_memory)
+					BOOST_CHECK(values[0].data() >= text.data() and values[0].data() < text.data() + text.length());
+			});
+
+		p->subscribe<std::string, int, std::optional<float>>("atom_site", { "type_symbol", "id", "B_iso_or_equiv" },
+			[&](std::string type, int id, std::optional<float> b)
+			{
+				atoms.emplace_back(type + std::to_string(id));
+				b_factors.emplace_back(b);
+			});
+
+		p->parse_file();
+
+		BOOST_CHECK(datablocks == (std::vector<std::string>{ "ONE", "TWO" }));
+		BOOST_CHECK(cells == (std::vector<std::string>{ "ONE/10.5", "TWO/" }));
+		BOOST_CHECK(atoms == (std::vector<std::string>{ "C1", "N2", "O3", "S1" }));
+		BOOST_CHECK(b_factors == (std::vector<std::optional<float>>{ 12.5f, std::nullopt, 7.f, std::nullopt }));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(streaming_parser_2)
+{
+	// '?' and missing items are passed as empty strings, '.' as is
+	const std::string text = R"(data_ONE
+loop_
+_test.id
+_test.value
+1 ?
+2 .
+3 '?'
+4 x
+)";
+
+	for (bool in_memory : { false, true })
+	{
+		std::istringstream is(text);
+		std::unique_ptr<cif::streaming_parser> p;
+		if (in_memory)
+			p.reset(new cif::streaming_parser(text.data(), text.length()));
+		else
+			p.reset(new cif::streaming_parser(is));
+
+		std::vector<std::string> values, missing;
+
+		p->subscribe("test", { "value", "missing" }, [&](const std::vector<std::string_view> &v)
+			{
+				values.emplace_back(v[0]);
+				missing.emplace_back(v[1]);
+			});
+
+		p->parse_file();
+
+		BOOST_CHECK(values == (std::vector<std::string>{ "", ".", "?", "x" }));
+		BOOST_CHECK(missing == (std::vector<std::string>(4, "")));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(bulk_insert_1)
+{
+	using namespace cif::literals;
+
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _datablock.description
+;
+    A test dictionary
+;
+    _dictionary.title	test_dict.dic
+    _dictionary.datablock_id	test_dict.dic
+    _dictionary.version	1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+    _item_type_list.detail
+               code      char
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+;              code item types/single words ...
+;
+               text      char
+               '[][ \n\t()_,.;:"&<>/\{}'`~!@#$%?+=*A-Za-z0-9|^-]*'
+;              text item types / multi-line text ...
+;
+
+save_cat_1
+    _category.description     'A simple test category'
+    _category.id              cat_1
+    _category.mandatory_code  no
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           code
+    save_
+
+save__cat_1.name
+    _item.name                '_cat_1.name'
+    _item.category_id         cat_1
+    _item.mandatory_code      no
+    _item_type.code           text
+    save_
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	cif::file f;
+	f.set_validator(&validator);
+
+	const std::string data = "data_test\nloop_\n_cat_1.id\n_cat_1.name\n1 Aap\n2 Noot\n3 Mies\n";
+	f.load(data.data(), data.length());
+
+	auto &cat1 = f.front()["cat_1"];
+
+	auto by_id = [&cat1](const std::string &id)
+	{
+		return cat1[{ { "id", id } }];
+	};
+
+	// Many rows, the index is rebuilt
+	{
+		cif::category::bulk_inserter bulk(cat1);
+		for (int i = 4; i < 1000; ++i)
+			bulk.emplace({ { "id", "x-" + std::to_string(i) }, { "name", "name " + std::to_string(i) } });
+		bulk.commit();
+	}
+
+	BOOST_CHECK_EQUAL(cat1.size(), 999);
+	BOOST_CHECK(cat1.is_valid());
+	BOOST_CHECK_EQUAL(by_id("x-500")["name"].as<std::string>(), "name 500");
+	BOOST_CHECK_EQUAL(by_id("2")["name"].as<std::string>(), "Noot");
+	BOOST_CHECK_THROW(cat1.emplace({ { "id", "x-4" } }), cif::duplicate_key_error);
+
+	// A few rows, the index is updated
+	{
+		cif::category::bulk_inserter bulk(cat1);
+		bulk.emplace({ { "id", "y-1" }, { "name", "y" } });
+		bulk.emplace({ { "id", "y-2" }, { "name", "y" } });
+		bulk.commit();
+	}
+
+	BOOST_CHECK_EQUAL(cat1.size(), 1001);
+
+	// When an exception is thrown, the destructor commits
+	try
+	{
+		cif::category::bulk_inserter bulk(cat1);
+		bulk.emplace({ { "id", "w-1" }, { "name", "w" } });
+		throw std::runtime_error("oops");
+	}
+	catch (const std::runtime_error &)
+	{
+	}
+
+	BOOST_CHECK_EQUAL(cat1.size(), 1002);
+	BOOST_CHECK(by_id("w-1"));
+	BOOST_CHECK_THROW(cat1.emplace({ { "id", "w-1" } }), cif::duplicate_key_error);
+	BOOST_CHECK(cat1.is_valid());
+	BOOST_CHECK_EQUAL(cat1.find("name"_key == "y").size(), 2);
+	BOOST_CHECK(by_id("y-2"));
+
+	// Duplicates are reported all at once and removed
+	for (int n : { 3, 100 })
+	{
+		cif::category::bulk_inserter bulk(cat1);
+
+		bulk.emplace({ { "id", "1" }, { "name", "duplicate" } });
+		for (int i = 0; i < n; ++i)
+			bulk.emplace({ { "id", "z-" + std::to_string(n) + '-' + std::to_string(i) } });
+		bulk.emplace({ { "id", "z-" + std::to_string(n) + "-0" }, { "name", "duplicate" } });
+
+		try
+		{
+			bulk.commit();
+			BOOST_FAIL("Expected a duplicate_key_error");
+		}
+		catch (const cif::duplicate_key_error &ex)
+		{
+			std::string msg = ex.what();
+			BOOST_CHECK_EQUAL(std::count(msg.begin(), msg.end(), '\n'), 1);
+		}
+
+		BOOST_CHECK(cat1.is_valid());
+		BOOST_CHECK(cat1.find("name"_key == "duplicate").empty());
+		BOOST_CHECK_EQUAL(by_id("1")["name"].as<std::string>(), "Aap");
+	}
+
+	BOOST_CHECK_EQUAL(cat1.size(), 1002 + 3 + 100);
+}
+
+BOOST_AUTO_TEST_CASE(validate_1)
+{
+	const char dict[] = R"(
+data_test_dict.dic
+    _datablock.id	test_dict.dic
+    _datablock.description
+;
+    A test dictionary
+;
+    _dictionary.title	test_dict.dic
+    _dictionary.datablock_id	test_dict.dic
+    _dictionary.version	1.0
+
+     loop_
+    _item_type_list.code
+    _item_type_list.primitive_code
+    _item_type_list.construct
+    _item_type_list.detail
+               code      char
+               '[][_,.;:"&<>()/\{}'`~!@#$%A-Za-z0-9*|+-]*'
+;              code item types/single words ...
+;
+               int       numb
+               '[+-]?[0-9]+'
+;              int item types are the subset of numbers that are the negative
+               or positive integers.
+;
+
+save_cat_1
+    _category.description     'A simple test category'
+    _category.id              cat_1
+    _category.mandatory_code  no
+    _category_key.name        '_cat_1.id'
+    save_
+
+save__cat_1.id
+    _item.name                '_cat_1.id'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           int
+    save_
+
+save__cat_1.name
+    _item.name                '_cat_1.name'
+    _item.category_id         cat_1
+    _item.mandatory_code      yes
+    _item_type.code           code
+    save_
+    )";
+
+	struct membuf : public std::streambuf
+	{
+		membuf(char *text, size_t length)
+		{
+			this->setg(text, text, text + length);
+		}
+	} buffer(const_cast<char *>(dict), sizeof(dict) - 1);
+
+	std::istream is_dict(&buffer);
+
+	auto validator = cif::parse_dictionary("test", is_dict);
+
+	std::string data = "data_test\n_cat_2.id 1\nloop_\n_cat_1.id\n_cat_1.name\n_cat_1.extra\n";
+	for (int i = 0; i < 25000; ++i)
+	{
+		if (i == 12345)
+			data += "aap noot 1\n";
+		else if (i == 20000)
+			data += "2.0e4 n20000 1\n";
+		else
+			data += std::to_string(i) + " n" + std::to_string(i) + " 1\n";
+	}
+
+	cif::file f;
+	f.set_validator(&validator);
+	f.load(data.data(), data.length());
+
+	auto report = f.validate(1);
+	BOOST_CHECK(report == f.validate(4));
+
+	BOOST_REQUIRE_EQUAL(report.size(), 4);
+
+	BOOST_CHECK_EQUAL(report[0].m_datablock, "test");
+	BOOST_CHECK_EQUAL(report[0].m_category, "cat_1");
+	BOOST_CHECK_EQUAL(report[0].m_item, "extra");
+	BOOST_CHECK_EQUAL(report[0].m_row, std::string::npos);
+
+	BOOST_CHECK_EQUAL(report[1].m_item, "id");
+	BOOST_CHECK_EQUAL(report[1].m_row, 12345);
+
+	BOOST_CHECK_EQUAL(report[2].m_item, "id");
+	BOOST_CHECK_EQUAL(report[2].m_row, 20000);
+
+	BOOST_CHECK_EQUAL(report[3].m_category, "cat_2");
+	BOOST_CHECK_EQUAL(report[3].m_row, std::string::npos);
+}
+
 BOOST_AUTO_TEST_CASE(output_test_1)
 {
 	auto data1 = R"(
@@ -3161,3 +5227,51 @@ BOOST_AUTO_TEST_CASE(compound_test_1)
 	BOOST_ASSERT(compound != nullptr);
 	BOOST_CHECK(compound->id() == "REA_v2");
 }
+
+BOOST_AUTO_TEST_CASE(compound_test_2)
+{
+	// The index of a CCD file is stored next to it and reused
+
+	namespace fs = std::filesystem;
+
+	auto dir = fs::temp_directory_path() / "cifpp-ccd-test";
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+
+	auto ccd = dir / "components.cif";
+	auto idx = dir / "components.cif.idx";
+	fs::copy_file(gTestDir / ".." / "data" / "ccd-subset.cif", ccd, fs::copy_options::overwrite_existing);
+
+	auto load = [&](const std::string &id)
+	{
+		cif::compound_factory::clear();
+		cif::compound_factory::instance().set_default_dictionary(ccd);
+		auto compound = cif::compound_factory::instance().create(id);
+		BOOST_REQUIRE(compound != nullptr);
+		BOOST_CHECK_EQUAL(compound->id(), id);
+	};
+
+	// written on first load
+	BOOST_CHECK(not fs::exists(idx));
+	load("ARG");
+	BOOST_REQUIRE(fs::exists(idx));
+
+	// reused on the second, the index file is not written again
+	auto old_time = fs::last_write_time(idx) - std::chrono::hours(1);
+	fs::last_write_time(idx, old_time);
+
+	load("GLY");
+	BOOST_CHECK(fs::last_write_time(idx) == old_time);
+
+	// and rebuilt after the CCD file changed
+	{
+		std::ofstream out(ccd, std::ios::app);
+		out << "# changed" << std::endl;
+	}
+
+	load("ASN");
+	BOOST_CHECK(fs::last_write_time(idx) != old_time);
+
+	cif::compound_factory::clear();
+	fs::remove_all(dir);
+}